@@ -0,0 +1,97 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+#pragma once
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+//
+//  Bytecode
+//
+//  Each instruction is a one byte opcode followed by its operands. Operands
+//  are stored unaligned in little-endian order, so they are read and written
+//  with memcpy.
+//
+
+// Limits for a single block of code
+#define CODE_DEPTH_MAX (64) // Most values one block of code may have on the stack
+#define CODE_LOOPS_MAX (16) // Deepest nesting of loops in one block of code
+
+// Opcodes
+#define OP_END (0)            // End of the code
+#define OP_NUMBER (1)         // Push a number; operand: float
+#define OP_PRIMITIVE (2)      // Call a primitive; operand: uint8_t primitive index
+#define OP_REPEAT (3)         // Pop a count and start a loop; operand: uint16_t offset past OP_LOOP
+#define OP_LOOP (4)           // Next iteration of a loop; operand: uint16_t offset back to the body
+#define OP_CALL (5)           // Call a procedure; operand: uint16_t procedure index
+#define OP_VARIABLE (6)       // Push the value of a variable; operand: uint16_t symbol id
+#define OP_JUMP (7)           // Jump forward; operand: uint16_t offset
+#define OP_JUMP_FALSE (8)     // Pop a value and jump forward if it is false; operand: uint16_t offset
+#define OP_STOP (9)           // Return from a procedure
+#define OP_OUTPUT (10)        // Return from a procedure with the value on the stack
+#define OP_TAIL_CALL (11)     // Call a procedure in place of the running one; operand: uint16_t procedure index
+#define OP_WORD (12)          // Push a quoted word; operand: uint16_t symbol id
+#define OP_LIST (13)          // Build and push a list; operands: const char * source text, uint16_t length
+#define OP_ADD (14)           // Pop two numbers and push their sum
+#define OP_SUBTRACT (15)      // Pop two numbers and push their difference
+#define OP_MULTIPLY (16)      // Pop two numbers and push their product
+#define OP_DIVIDE (17)        // Pop two numbers and push their quotient
+#define OP_NEGATE (18)        // Pop a number and push its negative
+#define OP_EQUAL (19)         // Pop two values and push true if they are equal
+#define OP_NOT_EQUAL (20)     // Pop two values and push true if they are not equal
+#define OP_LESS (21)          // Pop two numbers and push true if the first is less
+#define OP_GREATER (22)       // Pop two numbers and push true if the first is greater
+#define OP_LESS_EQUAL (23)    // Pop two numbers and push true if the first is less or equal
+#define OP_GREATER_EQUAL (24) // Pop two numbers and push true if the first is greater or equal
+#define OP_INTEGER (25)       // Push a whole number; operand: int32_t
+#define OP_ASK (26)           // Pop turtles and tell them until OP_ASKED
+#define OP_ASKED (27)         // Go back to the turtles told before the matching OP_ASK
+
+// A block of compiled code
+typedef struct
+{
+    uint8_t *bytes;    // The instructions
+    uint16_t length;   // Number of bytes used
+    uint16_t capacity; // Number of bytes available
+    uint8_t depth;     // Most values the code has on the stack at once
+    uint8_t loops;     // Deepest nesting of loops in the code
+    bool outputs;      // The code has an OUTPUT instruction
+    bool undefined;    // Compiling stopped at a word that is not defined yet
+} code_t;
+
+// Read a 16-bit operand
+static inline uint16_t code_read_u16(const uint8_t *ip)
+{
+    uint16_t value;
+    memcpy(&value, ip, sizeof(value));
+    return value;
+}
+
+// Read a 32-bit integer operand
+static inline int32_t code_read_i32(const uint8_t *ip)
+{
+    int32_t value;
+    memcpy(&value, ip, sizeof(value));
+    return value;
+}
+
+// Read a pointer operand
+static inline const char *code_read_pointer(const uint8_t *ip)
+{
+    const char *value;
+    memcpy(&value, ip, sizeof(value));
+    return value;
+}
+
+// Read a float operand
+static inline float code_read_float(const uint8_t *ip)
+{
+    float value;
+    memcpy(&value, ip, sizeof(value));
+    return value;
+}
@@ -0,0 +1,755 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+//
+//  Logo compiler
+//
+//  Compiles a line of Logo, or the body of a procedure, into bytecode for
+//  the VM in a single pass. Every primitive and procedure has a fixed number
+//  of inputs (see primitives.def), so a call is compiled by compiling that
+//  many expressions and then the call itself. The bracketed inputs of
+//  REPEAT, IF, IFELSE and ASK are compiled inline as loops and jumps rather
+//  than kept as lists. A list given as data is compiled to a reference to its
+//  text, and the VM builds it on the heap each time it is needed.
+//
+//  Each input is a full infix expression, parsed by precedence climbing:
+//  comparisons bind loosest, then + and -, then * and /, then unary minus.
+//  Operators compile to their own opcodes rather than primitive calls, and
+//  an operator whose inputs are both constants is worked out here, so
+//  360 / 5 costs no more at run time than 72.
+//
+//  The compiler also records the most values each block of code has on the
+//  stack and how deeply its loops nest, so the VM only checks for overflow
+//  when a procedure is called. It notes whether it compiled an OUTPUT and
+//  whether it stopped at a word that is not defined yet, which settles
+//  whether a procedure outputs and whether its body can wait.
+//
+//  Once a procedure body is compiled, calls made as the last thing the
+//  procedure does are changed to tail calls, so procedures that loop by
+//  calling themselves run in constant space.
+//
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "compiler.h"
+#include "evaluate.h"
+#include "lexer.h"
+#include "primitives.h"
+#include "procedures.h"
+#include "symbols.h"
+#include "vm.h"
+
+// Compiler state
+typedef struct
+{
+    lexer_t lexer;                // Source of tokens
+    code_t *code;                 // Destination for the bytecode
+    uint8_t depth;                // Number of values on the stack at this point
+    uint8_t loops;                // Number of loops enclosing this point
+    uint8_t asks;                 // Number of ASKs enclosing this point
+    const procedure_t *procedure; // Procedure being compiled, or NULL at top level
+} compiler_t;
+
+// An infix operator
+typedef struct
+{
+    const char *name;   // The operator as written
+    uint8_t op;         // Opcode that applies it
+    uint8_t precedence; // Higher binds more tightly
+} operator_t;
+
+static const operator_t operators[] = {
+    {"=", OP_EQUAL, 1},
+    {"<>", OP_NOT_EQUAL, 1},
+    {"<", OP_LESS, 1},
+    {">", OP_GREATER, 1},
+    {"<=", OP_LESS_EQUAL, 1},
+    {">=", OP_GREATER_EQUAL, 1},
+    {"+", OP_ADD, 2},
+    {"-", OP_SUBTRACT, 2},
+    {"*", OP_MULTIPLY, 3},
+    {"/", OP_DIVIDE, 3},
+};
+
+static bool compile_expression(compiler_t *compiler, const char *caller);
+static bool compile_statement(compiler_t *compiler);
+
+//
+//  Helper functions
+//
+
+// Append bytes to the code
+static bool emit(compiler_t *compiler, const void *bytes, uint16_t length)
+{
+    code_t *code = compiler->code;
+    if (code->length + length > code->capacity)
+    {
+        evaluate_error("Too much code");
+        return false;
+    }
+    memcpy(code->bytes + code->length, bytes, length);
+    code->length += length;
+    return true;
+}
+
+static bool emit_op(compiler_t *compiler, uint8_t op)
+{
+    return emit(compiler, &op, sizeof(op));
+}
+
+static bool emit_u16(compiler_t *compiler, uint16_t value)
+{
+    return emit(compiler, &value, sizeof(value));
+}
+
+// Patch a 16-bit operand emitted earlier
+static void patch_u16(compiler_t *compiler, uint16_t at, uint16_t value)
+{
+    memcpy(compiler->code->bytes + at, &value, sizeof(value));
+}
+
+// Intern a word, setting the error if there is no room
+static symbol_t *intern(const token_t *token)
+{
+    symbol_t *symbol = symbol_intern(token->text, token->length);
+    if (!symbol)
+    {
+        evaluate_error("Out of space for words");
+    }
+    return symbol;
+}
+
+// Account for a value pushed onto the stack
+static bool push(compiler_t *compiler)
+{
+    if (compiler->depth == CODE_DEPTH_MAX)
+    {
+        evaluate_error("Expression too complex");
+        return false;
+    }
+    compiler->depth++;
+    if (compiler->depth > compiler->code->depth)
+    {
+        compiler->code->depth = compiler->depth;
+    }
+    return true;
+}
+
+// Emit a forward jump, returning the location of its operand to patch
+static bool emit_jump(compiler_t *compiler, uint8_t op, uint16_t *operand)
+{
+    if (!emit_op(compiler, op) || !emit_u16(compiler, 0))
+    {
+        return false;
+    }
+    *operand = compiler->code->length - sizeof(uint16_t);
+    return true;
+}
+
+// Point a forward jump at the current location
+static void patch_jump(compiler_t *compiler, uint16_t operand)
+{
+    patch_u16(compiler, operand, compiler->code->length - operand - sizeof(uint16_t));
+}
+
+// Find the operator a token stands for
+static const operator_t *find_operator(const token_t *token)
+{
+    for (size_t i = 0; i < sizeof(operators) / sizeof(operators[0]); i++)
+    {
+        if (strlen(operators[i].name) == token->length &&
+            strncmp(operators[i].name, token->text, token->length) == 0)
+        {
+            return &operators[i];
+        }
+    }
+    return NULL;
+}
+
+// Check if the code from start to end is a single number, and get it
+static bool constant_at(compiler_t *compiler, uint16_t start, uint16_t end, value_t *number)
+{
+    const uint8_t *bytes = compiler->code->bytes + start;
+    if (end - start == 1 + sizeof(float) && bytes[0] == OP_NUMBER)
+    {
+        *number = value_number(code_read_float(bytes + 1));
+        return true;
+    }
+    if (end - start == 1 + sizeof(int32_t) && bytes[0] == OP_INTEGER)
+    {
+        *number = value_integer(code_read_i32(bytes + 1));
+        return true;
+    }
+    return false;
+}
+
+// Replace the code from at to the end with a constant
+static bool emit_constant(compiler_t *compiler, uint16_t at, value_t value)
+{
+    compiler->code->length = at;
+    if (value.type == VALUE_NUMBER)
+    {
+        return emit_op(compiler, OP_NUMBER) && emit(compiler, &value.number, sizeof(value.number));
+    }
+    if (value.type == VALUE_INTEGER)
+    {
+        return emit_op(compiler, OP_INTEGER) && emit(compiler, &value.integer, sizeof(value.integer));
+    }
+    return emit_op(compiler, OP_WORD) && emit_u16(compiler, value.symbol);
+}
+
+//
+//  Code generation
+//
+
+// Compile the inputs to a primitive or procedure
+static bool compile_inputs(compiler_t *compiler, const char *name, uint8_t inputs)
+{
+    for (int i = 0; i < inputs; i++)
+    {
+        if (!compile_expression(compiler, name))
+        {
+            return false;
+        }
+    }
+    compiler->depth -= inputs;
+    return true;
+}
+
+// Compile statements up to the closing bracket of a block
+static bool compile_block(compiler_t *compiler)
+{
+    while (lexer_peek(&compiler->lexer)->type != TOKEN_RIGHT_BRACKET)
+    {
+        if (lexer_peek(&compiler->lexer)->type == TOKEN_END)
+        {
+            evaluate_error("Missing ]");
+            return false;
+        }
+        if (!compile_statement(compiler))
+        {
+            return false;
+        }
+    }
+    lexer_next(&compiler->lexer); // Consume the ]
+    return true;
+}
+
+// Compile the opening bracket of a block that is an input to name
+static bool compile_block_start(compiler_t *compiler, const char *name)
+{
+    token_t token = lexer_next(&compiler->lexer);
+    if (token.type != TOKEN_LEFT_BRACKET)
+    {
+        if (token.type == TOKEN_END)
+        {
+            evaluate_error("Not enough inputs to %s", name);
+        }
+        else
+        {
+            evaluate_error("%s doesn't like %.*s as input", name, token.length, token.text);
+        }
+        return false;
+    }
+    return true;
+}
+
+// repeat count [statements]
+static bool compile_repeat(compiler_t *compiler)
+{
+    if (!compile_expression(compiler, "repeat") || !compile_block_start(compiler, "repeat"))
+    {
+        return false;
+    }
+    if (compiler->loops == CODE_LOOPS_MAX)
+    {
+        evaluate_error("Too many nested repeats");
+        return false;
+    }
+
+    // The count is consumed by OP_REPEAT, which skips the loop if it is zero
+    uint16_t exit;
+    if (!emit_jump(compiler, OP_REPEAT, &exit))
+    {
+        return false;
+    }
+    compiler->depth--;
+    uint16_t body = compiler->code->length;
+
+    if (++compiler->loops > compiler->code->loops)
+    {
+        compiler->code->loops = compiler->loops;
+    }
+    if (!compile_block(compiler))
+    {
+        return false;
+    }
+    compiler->loops--;
+
+    if (!emit_op(compiler, OP_LOOP) ||
+        !emit_u16(compiler, compiler->code->length + sizeof(uint16_t) - body))
+    {
+        return false;
+    }
+    patch_jump(compiler, exit);
+    return true;
+}
+
+// if condition [statements]
+// ifelse condition [statements] [statements]
+static bool compile_if(compiler_t *compiler, const char *name, bool has_else)
+{
+    uint16_t skip;
+    if (!compile_expression(compiler, name) ||
+        !compile_block_start(compiler, name) ||
+        !emit_jump(compiler, OP_JUMP_FALSE, &skip))
+    {
+        return false;
+    }
+    compiler->depth--;
+
+    if (!compile_block(compiler))
+    {
+        return false;
+    }
+
+    if (has_else)
+    {
+        uint16_t done;
+        if (!emit_jump(compiler, OP_JUMP, &done))
+        {
+            return false;
+        }
+        patch_jump(compiler, skip);
+        if (!compile_block_start(compiler, name) || !compile_block(compiler))
+        {
+            return false;
+        }
+        skip = done;
+    }
+
+    patch_jump(compiler, skip);
+    return true;
+}
+
+// ask turtles [statements]
+static bool compile_ask(compiler_t *compiler)
+{
+    if (!compile_expression(compiler, "ask") ||
+        !compile_block_start(compiler, "ask") ||
+        !emit_op(compiler, OP_ASK))
+    {
+        return false;
+    }
+    compiler->depth--;
+
+    compiler->asks++;
+    if (!compile_block(compiler))
+    {
+        return false;
+    }
+    compiler->asks--;
+    return emit_op(compiler, OP_ASKED);
+}
+
+// stop and output, which leave the procedure being compiled and any ASKs
+// it is running
+static bool compile_return(compiler_t *compiler, int index)
+{
+    const char *name = primitives[index].name;
+    if (!compiler->procedure)
+    {
+        evaluate_error("Can only use %s inside a procedure", name);
+        return false;
+    }
+
+    uint8_t op = OP_STOP;
+    if (index == PRIM_OUTPUT)
+    {
+        if (!compile_expression(compiler, name))
+        {
+            return false;
+        }
+        compiler->depth--;
+        compiler->code->outputs = true;
+        op = OP_OUTPUT;
+    }
+    for (int i = 0; i < compiler->asks; i++)
+    {
+        if (!emit_op(compiler, OP_ASKED))
+        {
+            return false;
+        }
+    }
+    return emit_op(compiler, op);
+}
+
+// Compile a word as a call. The caller is the name of the procedure the
+// output goes to, or NULL if the word starts a statement.
+static bool compile_word(compiler_t *compiler, const token_t *token, const char *caller)
+{
+    symbol_t *symbol = intern(token);
+    if (!symbol)
+    {
+        return false;
+    }
+
+    const char *name = symbol->name;
+    bool outputs;
+    if (symbol->primitive >= 0)
+    {
+        outputs = primitives[symbol->primitive].outputs;
+        name = primitives[symbol->primitive].name;
+    }
+    else if (symbol->procedure >= 0)
+    {
+        outputs = procedures[symbol->procedure].outputs;
+    }
+    else
+    {
+        compiler->code->undefined = true;
+        evaluate_error("I don't know how to %s", name);
+        return false;
+    }
+
+    if (caller && !outputs)
+    {
+        evaluate_error("%s didn't output to %s", name, caller);
+        return false;
+    }
+    if (!caller && outputs)
+    {
+        evaluate_error("You don't say what to do with %s", name);
+        return false;
+    }
+
+    if (symbol->procedure >= 0)
+    {
+        if (!compile_inputs(compiler, name, procedures[symbol->procedure].inputs) ||
+            !emit_op(compiler, OP_CALL) ||
+            !emit_u16(compiler, (uint16_t)symbol->procedure))
+        {
+            return false;
+        }
+        return !outputs || push(compiler);
+    }
+
+    int index = symbol->primitive;
+    switch (index)
+    {
+    case PRIM_REPEAT:
+        return compile_repeat(compiler);
+    case PRIM_IF:
+        return compile_if(compiler, name, false);
+    case PRIM_IFELSE:
+        return compile_if(compiler, name, true);
+    case PRIM_ASK:
+        return compile_ask(compiler);
+    case PRIM_STOP:
+    case PRIM_OUTPUT:
+        return compile_return(compiler, index);
+    }
+
+    uint8_t call[2] = {OP_PRIMITIVE, (uint8_t)index};
+    if (!compile_inputs(compiler, name, primitives[index].inputs) ||
+        !emit(compiler, call, sizeof(call)))
+    {
+        return false;
+    }
+    return !outputs || push(compiler);
+}
+
+// Compile a list given as data, up to its matching ]
+static bool compile_list(compiler_t *compiler, const token_t *open)
+{
+    const char *start = open->text + 1;
+    int depth = 1;
+    token_t token;
+
+    do
+    {
+        token = lexer_next(&compiler->lexer);
+        if (token.type == TOKEN_END)
+        {
+            evaluate_error("Missing ]");
+            return false;
+        }
+        depth += token.type == TOKEN_LEFT_BRACKET;
+        depth -= token.type == TOKEN_RIGHT_BRACKET;
+    } while (depth);
+
+    if (token.text - start > UINT16_MAX)
+    {
+        evaluate_error("List too long");
+        return false;
+    }
+    if (!emit_op(compiler, OP_LIST) || !emit(compiler, &start, sizeof(start)) ||
+        !emit_u16(compiler, token.text - start))
+    {
+        return false;
+    }
+    return push(compiler);
+}
+
+// Compile a single value: a constant, a variable, a call that outputs,
+// a negated value or an expression in parentheses
+static bool compile_primary(compiler_t *compiler, const char *caller)
+{
+    token_t token = lexer_next(&compiler->lexer);
+
+    switch (token.type)
+    {
+    case TOKEN_NEGATE:
+    {
+        uint16_t start = compiler->code->length;
+        if (!compile_primary(compiler, "-"))
+        {
+            return false;
+        }
+        value_t number, result;
+        if (constant_at(compiler, start, compiler->code->length, &number) &&
+            vm_arithmetic(OP_NEGATE, number, number, &result))
+        {
+            return emit_constant(compiler, start, result);
+        }
+        return emit_op(compiler, OP_NEGATE);
+    }
+
+    case TOKEN_NUMBER:
+        if (!emit_constant(compiler, compiler->code->length,
+                           token.whole ? value_integer(token.integer) : value_number(token.number)))
+        {
+            return false;
+        }
+        return push(compiler);
+
+    case TOKEN_WORD:
+        return compile_word(compiler, &token, caller);
+
+    case TOKEN_QUOTED:
+    {
+        symbol_t *symbol = intern(&token);
+        if (!symbol)
+        {
+            return false;
+        }
+        if (!emit_op(compiler, OP_WORD) || !emit_u16(compiler, symbol_id(symbol)))
+        {
+            return false;
+        }
+        return push(compiler);
+    }
+
+    case TOKEN_LEFT_BRACKET:
+        return compile_list(compiler, &token);
+
+    case TOKEN_VARIABLE:
+    {
+        symbol_t *symbol = intern(&token);
+        if (!symbol)
+        {
+            return false;
+        }
+        if (!emit_op(compiler, OP_VARIABLE) || !emit_u16(compiler, symbol_id(symbol)))
+        {
+            return false;
+        }
+        return push(compiler);
+    }
+
+    case TOKEN_LEFT_PAREN:
+        if (!compile_expression(compiler, caller))
+        {
+            return false;
+        }
+        token = lexer_next(&compiler->lexer);
+        if (token.type != TOKEN_RIGHT_PAREN)
+        {
+            evaluate_error("Missing )");
+            return false;
+        }
+        return true;
+
+    case TOKEN_END:
+    case TOKEN_RIGHT_BRACKET:
+    case TOKEN_RIGHT_PAREN:
+        evaluate_error("Not enough inputs to %s", caller);
+        return false;
+
+    default:
+        evaluate_error("%s doesn't like %.*s as input", caller, token.length, token.text);
+        return false;
+    }
+}
+
+// Compile operators and their right-hand inputs for as long as they bind at
+// least as tightly as min_precedence
+static bool compile_infix(compiler_t *compiler, const char *caller, uint8_t min_precedence)
+{
+    uint16_t left = compiler->code->length;
+    if (!compile_primary(compiler, caller))
+    {
+        return false;
+    }
+
+    while (lexer_peek(&compiler->lexer)->type == TOKEN_OPERATOR)
+    {
+        const operator_t *operator = find_operator(lexer_peek(&compiler->lexer));
+        if (!operator || operator->precedence < min_precedence)
+        {
+            break;
+        }
+        lexer_next(&compiler->lexer);
+
+        // Operators of equal precedence group from the left
+        uint16_t right = compiler->code->length;
+        if (!compile_infix(compiler, operator->name, operator->precedence + 1))
+        {
+            return false;
+        }
+        compiler->depth--;
+
+        // Work out an operator on two constants as the VM would, leaving
+        // anything that would fail, like a division by zero, to run time
+        value_t x, y, result;
+        if (constant_at(compiler, left, right, &x) &&
+            constant_at(compiler, right, compiler->code->length, &y) &&
+            vm_arithmetic(operator->op, x, y, &result))
+        {
+            if (!emit_constant(compiler, left, result))
+            {
+                return false;
+            }
+        }
+        else if (!emit_op(compiler, operator->op))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Compile an expression that outputs a value for the caller
+static bool compile_expression(compiler_t *compiler, const char *caller)
+{
+    return compile_infix(compiler, caller, 1);
+}
+
+// Compile a command
+static bool compile_statement(compiler_t *compiler)
+{
+    token_t token = lexer_next(&compiler->lexer);
+
+    if (token.type == TOKEN_WORD)
+    {
+        return compile_word(compiler, &token, NULL);
+    }
+    if (token.type == TOKEN_RIGHT_BRACKET || token.type == TOKEN_RIGHT_PAREN)
+    {
+        evaluate_error("Unexpected %.*s", token.length, token.text);
+        return false;
+    }
+
+    evaluate_error("You don't say what to do with %.*s", token.length, token.text);
+    return false;
+}
+
+//
+//  Tail calls
+//
+
+// Length of an instruction including its operands
+static uint16_t instruction_length(uint8_t op)
+{
+    switch (op)
+    {
+    case OP_NUMBER:
+        return 1 + sizeof(float);
+    case OP_INTEGER:
+        return 1 + sizeof(int32_t);
+    case OP_PRIMITIVE:
+        return 1 + sizeof(uint8_t);
+    case OP_LIST:
+        return 1 + sizeof(const char *) + sizeof(uint16_t);
+    case OP_REPEAT:
+    case OP_LOOP:
+    case OP_CALL:
+    case OP_TAIL_CALL:
+    case OP_WORD:
+    case OP_VARIABLE:
+    case OP_JUMP:
+    case OP_JUMP_FALSE:
+        return 1 + sizeof(uint16_t);
+    default:
+        return 1;
+    }
+}
+
+// Change calls that are followed only by the return of the procedure into
+// tail calls. A call followed by END or STOP is a tail call when the
+// procedure does not output (otherwise returning would be an error the
+// tail call would hide); a call followed by OUTPUT always is.
+static void mark_tail_calls(code_t *code, const procedure_t *procedure)
+{
+    uint8_t *bytes = code->bytes;
+    uint16_t at = 0;
+
+    while (at < code->length)
+    {
+        uint16_t next = at + instruction_length(bytes[at]);
+        if (bytes[at] == OP_CALL)
+        {
+            // Follow jumps to the next instruction that does any work
+            uint16_t to = next;
+            while (bytes[to] == OP_JUMP)
+            {
+                to += instruction_length(OP_JUMP) + code_read_u16(bytes + to + 1);
+            }
+            if (bytes[to] == OP_OUTPUT ||
+                (!procedure->outputs && (bytes[to] == OP_END || bytes[to] == OP_STOP)))
+            {
+                bytes[at] = OP_TAIL_CALL;
+            }
+        }
+        at = next;
+    }
+}
+
+//
+//  Compiler functions
+//
+
+// Compile a line of Logo, or the body of a procedure, into bytecode
+int compile(code_t *code, const char *source, const procedure_t *procedure)
+{
+    compiler_t compiler = {.code = code, .procedure = procedure};
+    lexer_init(&compiler.lexer, source);
+    code->length = 0;
+    code->depth = 0;
+    code->loops = 0;
+    code->outputs = false;
+    code->undefined = false;
+
+    while (lexer_peek(&compiler.lexer)->type != TOKEN_END)
+    {
+        if (!compile_statement(&compiler))
+        {
+            return EVAL_STATE_ERROR;
+        }
+    }
+
+    if (!emit_op(&compiler, OP_END))
+    {
+        return EVAL_STATE_ERROR;
+    }
+    if (procedure)
+    {
+        mark_tail_calls(code, procedure);
+    }
+    return EVAL_STATE_COMPLETE;
+}
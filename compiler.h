@@ -0,0 +1,15 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#include "bytecode.h"
+#include "procedures.h"
+
+// Function prototypes
+int compile(code_t *code, const char *source, const procedure_t *procedure);
@@ -5,113 +5,96 @@
 //
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
-#include <stdlib.h>
+#include <strings.h>
 
 #include "pico/stdlib.h"
 
-#include "turtle.h"
+#include "compiler.h"
 #include "evaluate.h"
+#include "lexer.h"
+#include "picocalc/screen.h"
+#include "procedures.h"
+#include "vm.h"
 
 char error_message[256] = {0}; // Buffer for error messages
 char *last_error = error_message; // Pointer to the last error message
 
-void print_version(void);
-void print_license(void);
+static uint8_t line_code[EVAL_CODE_SIZE]; // Bytecode for the line being evaluated
+static bool defining = false;             // True between TO and END
 
-int evaluate(const char *expr)
+// Record an error message for the REPL to display
+// Always returns EVAL_STATE_ERROR so callers can return the result directly
+int evaluate_error(const char *format, ...)
 {
-    char *cmd = strtok((char *)expr, " ");
-    char *arg = strtok(NULL, " "); // Get the argument if any
+    va_list args;
+    va_start(args, format);
+    vsnprintf(error_message, sizeof(error_message), format, args);
+    va_end(args);
 
-    // This function evaluates the expression and returns the result.
-    // For now, it just returns a dummy value.
-    if (strcmp(cmd, "version") == 0)
-    {
-        print_version();
-        return EVAL_STATE_COMPLETE;
-    }
-    else if (strcmp(cmd, "license") == 0)
-    {
-        print_license();
-        return EVAL_STATE_COMPLETE;
-    }
-    else if (strcmp(cmd, "rt") == 0 || strcmp(cmd, "right") == 0)
-    {
-         // Turn right by the specified angle
-        turtle_set_angle(turtle_get_angle() + atof(arg));
+    return EVAL_STATE_ERROR;
+}
 
-        screen_gfx_update();
-        return EVAL_STATE_COMPLETE;
-    }
-    else if (strcmp(cmd, "lt") == 0 || strcmp(cmd, "left") == 0)
-    {
-        // Turn left by the specified angle
-        turtle_set_angle(turtle_get_angle() - atof(arg));
+// Check if the first word of the line is the given word
+static bool starts_with(const char *expr, const char *word)
+{
+    lexer_t lexer;
+    lexer_init(&lexer, expr);
+    const token_t *token = lexer_peek(&lexer);
+    return token->type == TOKEN_WORD &&
+           token->length == strlen(word) &&
+           strncasecmp(token->text, word, token->length) == 0;
+}
 
-        screen_gfx_update();
-        return EVAL_STATE_COMPLETE;
-    }
-    else if (strcmp(cmd, "fd") == 0 || strcmp(cmd, "forward") == 0)
-    {
-         // Move forward by the specified distance
-        turtle_move(atof(arg));
-        screen_gfx_update();
+// Collect a line of a procedure definition
+static int define(const char *expr)
+{
+    int state;
 
-        return EVAL_STATE_COMPLETE;
-    }
-    else if (strcmp(cmd, "bk") == 0 || strcmp(cmd, "back") == 0)
+    if (starts_with(expr, "end"))
     {
-        // Move backward by the specified distance
-        turtle_move(-atof(arg));
-        screen_gfx_update();
-
-        return EVAL_STATE_COMPLETE;
+        defining = false;
+        return procedure_end();
     }
-    else if (strcmp(cmd, "setcolor") == 0 || strcmp(cmd, "color") == 0)
-    {
-        // Convert hex color to uint16_t
-        turtle_set_colour((uint16_t)strtol(arg, NULL, 16));
 
-        screen_gfx_update();
-        return EVAL_STATE_COMPLETE;
-    }
-    else if (strcmp(cmd, "home") == 0)
+    state = procedure_add_line(expr);
+    if (state != EVAL_STATE_COMPLETE)
     {
-        turtle_home();
-
-        screen_gfx_update();
-        return EVAL_STATE_COMPLETE;
+        defining = false;
+        return state;
     }
-    else if (strcmp(cmd, "cs") == 0 || strcmp(cmd, "clearscreen") == 0)
-    {
-        turtle_clearscreen();
-        screen_gfx_update();
+    return EVAL_STATE_IN_PROC;
+}
 
-        return EVAL_STATE_COMPLETE;
-    }
-    else if (strcmp(cmd, "penup") == 0 || strcmp(cmd, "pu") == 0)
-    {
-        // Lift the pen up
-        turtle_set_pen_down(false);
-        return EVAL_STATE_COMPLETE;
-    }
-    else if (strcmp(cmd, "pendown") == 0 || strcmp(cmd, "pd") == 0)
+// Compile a line to bytecode and run it
+int evaluate(const char *expr)
+{
+    code_t code = {line_code, 0, sizeof(line_code)};
+
+    if (defining)
     {
-        turtle_set_pen_down(true);
-        return EVAL_STATE_COMPLETE;
+        return define(expr);
     }
-    else if (strcmp(cmd, "showturtle") == 0 || strcmp(cmd, "st") == 0)
+    if (starts_with(expr, "to"))
     {
-        turtle_set_visibility(true);
-        return EVAL_STATE_COMPLETE;
+        int state = procedure_begin(expr);
+        if (state != EVAL_STATE_COMPLETE)
+        {
+            return state;
+        }
+        defining = true;
+        return EVAL_STATE_IN_PROC;
     }
-    else if (strcmp(cmd, "hideturtle") == 0 || strcmp(cmd, "ht") == 0)
+
+    int state = compile(&code, expr, NULL);
+    if (state != EVAL_STATE_COMPLETE)
     {
-        turtle_set_visibility(false);
-        return EVAL_STATE_COMPLETE;
+        return state;
     }
 
-    snprintf(error_message, sizeof(error_message), "I don't know how to %s", expr);
-    return EVAL_STATE_ERROR;
-}
\ No newline at end of file
+    // Drawing only changes the frame buffer: show it once the line has run
+    state = vm_run(&code);
+    screen_gfx_update();
+    return state;
+}
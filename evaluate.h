@@ -13,7 +13,10 @@
 #define EVAL_STATE_IN_WORD (2)  // Evaluation is in the middle of a word
 #define EVAL_STATE_IN_PROC (3)  // Evaluation is in a procedure or function
 
+#define EVAL_CODE_SIZE (1024) // Bytes of bytecode available to a line typed at the prompt
+
 extern char *last_error; // Pointer to the last error message
 
 // Function Prototypes
-int evaluate(const char *expr);
\ No newline at end of file
+int evaluate(const char *expr);
+int evaluate_error(const char *format, ...);
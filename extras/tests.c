@@ -3,8 +3,14 @@
 //  Copyright Blair Leduc.
 //  See LICENSE for details.
 //
+//  Tests and benchmarks that run on the PicoCalc itself. Each one is called
+//  from main in place of the REPL, prints its results to the serial port
+//  and the screen, and then stops. There is no host build, so checks of
+//  the interpreter and the graphics run here on the device as well.
+//
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
@@ -15,6 +21,11 @@
 #include "picocalc/screen.h"
 #include "picocalc/picocalc.h"
 #include "drivers/keyboard.h"
+#include "evaluate.h"
+#include "number.h"
+#include "vm.h"
+#include "picture.h"
+#include "turtle.h"
 
 #define M_PI		(3.14159265358979323846)
 
@@ -213,7 +224,7 @@ void gamma_test(void)
             int y2 = cy - (int)(sinf(rad) * center_offset + 0.5f);
 
             // Draw line from center to circumference
-            screen_gfx_line(cx, cy, x2, y2, colors[c] & levels[angle / 15]);
+            screen_gfx_line(cx, cy, x2, y2, colors[c] & levels[angle / 15], false);
         }
     }
 
@@ -242,14 +253,67 @@ void rainbow_test(void)
     }
 }
 
+// The float DDA screen_gfx_line used before it stepped in fixed point,
+// kept to check that the same pixels are drawn and to time against
+static int reference_wrap(float value, int max)
+{
+    value = value - floorf(value / max) * max;
+    int pixel = (int)(value + 0.5f);
+    return ((pixel % max) + max) % max;
+}
+
+static void reference_line(float x1, float y1, float x2, float y2, uint16_t colour, bool xor)
+{
+    uint16_t *frame = screen_gfx_frame();
+    float dx = x2 - x1;
+    float dy = y2 - y1;
+    int steps = (int)ceilf(fmaxf(fabsf(dx), fabsf(dy)));
+    float x_inc = steps ? dx / steps : 0.0f;
+    float y_inc = steps ? dy / steps : 0.0f;
+    float x = x1;
+    float y = y1;
+    for (int i = 0; i <= steps; ++i)
+    {
+        uint16_t *pixel = &frame[reference_wrap(y, SCREEN_HEIGHT) * SCREEN_WIDTH + reference_wrap(x, SCREEN_WIDTH)];
+        *pixel = xor ? *pixel ^ colour : colour;
+        x += x_inc;
+        y += y_inc;
+    }
+}
+
+// Draw random lines with both a line function and return the pixels per second
+static uint32_t time_lines(void (*line)(float, float, float, float, uint16_t, bool), int count)
+{
+    uint32_t pixels = 0;
+    absolute_time_t start_time = get_absolute_time();
+    for (int i = 0; i < count; i++)
+    {
+        float x1 = get_rand_32() % SCREEN_WIDTH;
+        float y1 = get_rand_32() % SCREEN_HEIGHT;
+        float x2 = get_rand_32() % SCREEN_WIDTH;
+        float y2 = get_rand_32() % SCREEN_HEIGHT;
+        line(x1, y1, x2, y2, get_rand_32() % 0xFFFF, false);
+        pixels += (uint32_t)ceilf(fmaxf(fabsf(x2 - x1), fabsf(y2 - y1))) + 1;
+    }
+    screen_gfx_fence(); // Lines are drawn on core 1
+    int64_t elapsed = absolute_time_diff_us(start_time, get_absolute_time());
+    return (uint64_t)pixels * 1000000 / (elapsed ? elapsed : 1);
+}
+
 // Function to test drawing lines
-// This will draw random lines on the screen at 50Hz
-// and allow switching between text and graphics modes with F1, F2, F3 keys
+// This times the old float DDA against screen_gfx_line, then draws random
+// lines on the screen at 50Hz, printing the pixels drawn per second,
+// and allows switching between text and graphics modes with F1, F2, F3 keys
 // Press F1 for text mode, F2 for split mode, F3 for graphics mode
 void lines_test()
 {
+    printf("Float DDA: %lu pixels/s\n", (unsigned long)time_lines(reference_line, 1000));
+    printf("screen_gfx_line: %lu pixels/s\n", (unsigned long)time_lines(screen_gfx_line, 1000));
+
     absolute_time_t start_time = get_absolute_time();
-    int counter = 1;
+    absolute_time_t report_time = start_time;
+    int64_t drawing = 0;
+    uint32_t pixels = 0;
     while (true)
     {
         absolute_time_t now = get_absolute_time();
@@ -258,6 +322,13 @@ void lines_test()
             start_time = now;
             screen_gfx_update(); // Update the gfx screen at 50Hz
         }
+        if (absolute_time_diff_us(report_time, now) >= 1000000)
+        {
+            report_time = now;
+            printf("%lld pixels/s\n", (long long)pixels * 1000000 / (drawing ? drawing : 1));
+            pixels = 0;
+            drawing = 0;
+        }
 
         // Draw a line between two random points with a random colour
         int x1 = get_rand_32() % SCREEN_WIDTH;
@@ -265,9 +336,11 @@ void lines_test()
         int x2 = get_rand_32() % SCREEN_WIDTH;
         int y2 = get_rand_32() % SCREEN_HEIGHT;
         uint16_t color = get_rand_32() % 0xFFFF;
-        screen_gfx_line(x1, y1, x2, y2, color);
-
-        printf("%d: (%d, %d) to (%d, %d) in colour 0x%04X\n", counter++, x1, y1, x2, y2, color);
+        absolute_time_t line_start = get_absolute_time();
+        screen_gfx_line(x1, y1, x2, y2, color, false);
+        screen_gfx_fence();
+        drawing += absolute_time_diff_us(line_start, get_absolute_time());
+        pixels += MAX(abs(x2 - x1), abs(y2 - y1)) + 1;
 
         if (keyboard_key_available())
         {
@@ -289,3 +362,902 @@ void lines_test()
         tight_loop_contents();
     }
 }
+
+// Check that screen_gfx_line draws exactly the pixels the float DDA did,
+// for lines on and off the screen, wrapping, near zero, at half pixels and
+// at the angles the turtle draws. Each line is drawn twice with XOR by
+// both, so any pixel that differs is left set.
+void line_golden_test(void)
+{
+    uint16_t *frame = screen_gfx_frame();
+    uint32_t seed = 12345;
+    int failed = 0;
+    const int count = 20000;
+
+    for (int i = 0; i < count; i++)
+    {
+        float c[4];
+        for (int j = 0; j < 4; j++)
+        {
+            seed = seed * 1664525 + 1013904223; // Same lines on every run
+            float r = (seed >> 8) / 16777216.0f;
+            switch (i % 5)
+            {
+            case 0:
+                c[j] = (float)(seed % SCREEN_WIDTH); // Whole pixels
+                break;
+            case 1:
+                c[j] = r * SCREEN_WIDTH; // Anywhere on the screen
+                break;
+            case 2:
+                c[j] = r * 2000.0f - 1000.0f; // Wrapping several times
+                break;
+            case 3:
+                c[j] = (r - 0.5f) * 0.01f; // Crossing zero
+                break;
+            default:
+                c[j] = (float)(seed % 640) - 320.0f + 0.5f; // Half pixels
+                break;
+            }
+        }
+        if (i % 2)
+        {
+            // As the turtle draws: a distance along a heading
+            float angle = (seed % 360) * (float)(M_PI / 180.0);
+            float distance = c[2] < 0 ? -c[2] : c[2];
+            c[2] = c[0] + distance * sinf(angle);
+            c[3] = c[1] - distance * cosf(angle);
+        }
+
+        screen_gfx_line(c[0], c[1], c[2], c[3], 0xFFFF, true);
+        reference_line(c[0], c[1], c[2], c[3], 0xFFFF, true);
+        for (int p = 0; p < SCREEN_WIDTH * SCREEN_HEIGHT; p++)
+        {
+            if (frame[p])
+            {
+                if (failed++ < 10)
+                {
+                    printf("Fail: (%g, %g) to (%g, %g)\n", c[0], c[1], c[2], c[3]);
+                }
+                screen_gfx_clear();
+                break;
+            }
+        }
+    }
+    printf("Lines: %d of %d differ\n", failed, count);
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// A random number from low to high, the same on every run from the same seed
+static float seeded_random(uint32_t *seed, float low, float high)
+{
+    *seed = *seed * 1664525 + 1013904223;
+    return low + (high - low) * ((*seed >> 8) / 16777216.0f);
+}
+
+// Distance from the centre of a pixel to the nearest point of a segment
+static float segment_distance(int x, int y, float x1, float y1, float x2, float y2)
+{
+    float dx = x2 - x1;
+    float dy = y2 - y1;
+    float length2 = dx * dx + dy * dy;
+    float u = length2 > 0.0f ? ((x - x1) * dx + (y - y1) * dy) / length2 : 0.0f;
+    u = fminf(fmaxf(u, 0.0f), 1.0f);
+    return hypotf(x1 + u * dx - x, y1 + u * dy - y);
+}
+
+// Run a program and wait for core 1 to finish drawing it, returning how
+// many microseconds that took
+static int64_t time_program(const char *program)
+{
+    absolute_time_t start_time = get_absolute_time();
+    evaluate(program);
+    screen_gfx_fence();
+    return absolute_time_diff_us(start_time, get_absolute_time());
+}
+
+// Time a set of recursive drawing programs. Drawing and sending to the LCD
+// run on core 1 while core 0 runs the program; the time the same work
+// would take on one core is about the elapsed time plus the time core 1
+// was busy, less the time core 0 waited for it.
+void drawing_benchmark(void)
+{
+    const char *procedures[] = {
+        "to tree :n :len",
+        "if :n = 0 [stop]",
+        "fd :len lt 30 tree :n - 1 :len * 0.7 rt 60 tree :n - 1 :len * 0.7 lt 30 bk :len",
+        "end",
+        "to koch :n :len",
+        "if :n = 0 [fd :len stop]",
+        "koch :n - 1 :len / 3 lt 60 koch :n - 1 :len / 3 rt 120 koch :n - 1 :len / 3 lt 60 koch :n - 1 :len / 3",
+        "end",
+        "to dragon :n :len :turn",
+        "if :n = 0 [fd :len stop]",
+        "dragon :n - 1 :len 90 rt :turn dragon :n - 1 :len -90",
+        "end",
+    };
+    const char *programs[] = {
+        "cs tree 10 60",
+        "cs repeat 3 [koch 5 240 rt 120]",
+        "cs dragon 12 2 90",
+        "cs repeat 360 [fd 150 bk 150 rt 1]",
+    };
+
+    for (size_t i = 0; i < sizeof(procedures) / sizeof(procedures[0]); i++)
+    {
+        evaluate(procedures[i]);
+    }
+    for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++)
+    {
+        uint32_t drawing, waiting;
+        screen_gfx_times(&drawing, &waiting);
+        int64_t elapsed = time_program(programs[i]);
+        screen_gfx_times(&drawing, &waiting);
+        int64_t one_core = elapsed + drawing - waiting;
+        int64_t speedup = one_core * 100 / (elapsed ? elapsed : 1);
+        printf("%s: %lld ms, one core %lld ms, %lld.%02lldx\n", programs[i], (long long)elapsed / 1000,
+               (long long)one_core / 1000, (long long)speedup / 100, (long long)speedup % 100);
+    }
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Time a drawing of 10,000 segments as it is shown while it runs and with
+// NOREFRESH, where only UPDATEGRAPH sends it to the LCD, and count the
+// updates and blits each takes
+void refresh_benchmark(void)
+{
+    const char *programs[] = {
+        "cs ht repeat 10000 [fd 150 rt 179.5]",
+        "norefresh cs ht repeat 10000 [fd 150 rt 179.5] updategraph refresh",
+    };
+
+    for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++)
+    {
+        uint32_t frames, blits;
+        screen_gfx_stats(&frames, &blits);
+        int64_t elapsed = time_program(programs[i]);
+        screen_gfx_stats(&frames, &blits);
+        printf("%s: %lld ms, %lu updates, %lu blits\n", programs[i], (long long)elapsed / 1000,
+               (unsigned long)frames, (unsigned long)blits);
+    }
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Time a zoomed-in drawing that mostly goes off the screen with lines
+// wrapped at the edges and clipped to them, then check that FENCE stops
+// the turtle at the edge
+void boundary_benchmark(void)
+{
+    const char *programs[] = {
+        "wrap cs ht tree 11 600",
+        "window cs ht tree 11 600",
+        "wrap cs ht repeat 1000 [fd 5000 bk 5000 rt 0.36]",
+        "window cs ht repeat 1000 [fd 5000 bk 5000 rt 0.36]",
+    };
+
+    evaluate("to tree :n :len");
+    evaluate("if :n = 0 [stop]");
+    evaluate("fd :len lt 30 tree :n - 1 :len * 0.7 rt 60 tree :n - 1 :len * 0.7 lt 30 bk :len");
+    evaluate("end");
+
+    for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++)
+    {
+        int64_t elapsed = time_program(programs[i]);
+        printf("%s: %lld ms\n", programs[i], (long long)elapsed / 1000);
+    }
+
+    int state = evaluate("fence cs fd 160 bk 320");
+    printf("Fence: %s (%s)\n", state == EVAL_STATE_ERROR ? "pass" : "fail", last_error);
+    evaluate("wrap");
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Check that lines clipped to the screen in WINDOW mode stay on the true
+// line. The lines start and end up to 400 pixels off the screen, or start
+// on it. Every pixel drawn must be within 0.75 of a pixel of the segment,
+// and a line that crosses the screen must draw something.
+void window_test(void)
+{
+    uint16_t *frame = screen_gfx_frame();
+    uint32_t seed = 3;
+    uint32_t far = 0;
+    uint32_t missing = 0;
+    const int count = 2000;
+
+    evaluate("window");
+    for (int i = 0; i < count; i++)
+    {
+        float x1 = seeded_random(&seed, -400.0f, 720.0f);
+        float y1 = seeded_random(&seed, -400.0f, 720.0f);
+        float x2 = seeded_random(&seed, -400.0f, 720.0f);
+        float y2 = seeded_random(&seed, -400.0f, 720.0f);
+        if (i % 4 == 0)
+        {
+            x1 = seeded_random(&seed, 0.0f, SCREEN_WIDTH - 1);
+            y1 = seeded_random(&seed, 0.0f, SCREEN_HEIGHT - 1);
+        }
+
+        screen_gfx_clear();
+        screen_gfx_line(x1, y1, x2, y2, COLOUR_WHITE, false);
+        screen_gfx_fence();
+
+        uint32_t drawn = 0;
+        for (int y = 0; y < SCREEN_HEIGHT; y++)
+        {
+            for (int x = 0; x < SCREEN_WIDTH; x++)
+            {
+                if (frame[y * SCREEN_WIDTH + x])
+                {
+                    drawn++;
+                    far += segment_distance(x, y, x1, y1, x2, y2) > 0.75f;
+                }
+            }
+        }
+
+        // Look for a point on the line that rounds to a pixel on the screen
+        int steps = (int)ceilf(fmaxf(fabsf(x2 - x1), fabsf(y2 - y1))) * 4;
+        for (int j = 0; j <= steps; j++)
+        {
+            float x = x1 + (x2 - x1) * j / steps;
+            float y = y1 + (y2 - y1) * j / steps;
+            if (x > -0.4f && x < SCREEN_WIDTH - 0.6f && y > -0.4f && y < SCREEN_HEIGHT - 0.6f)
+            {
+                missing += drawn == 0;
+                break;
+            }
+        }
+    }
+    evaluate("wrap");
+    printf("Window lines: %s (%lu pixels too far, %lu lines missing of %d)\n", far || missing ? "fail" : "pass",
+           (unsigned long)far, (unsigned long)missing, count);
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Time the same drawings with pens of different widths, against the
+// thinnest pen
+void pen_benchmark(void)
+{
+    const char *programs[] = {
+        "cs ht repeat 360 [fd 150 bk 150 rt 1]",
+        "cs ht repeat 10 [repeat 360 [fd 2 rt 1] rt 36]",
+    };
+    const int sizes[] = {1, 2, 4, 8, 16};
+
+    for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++)
+    {
+        int64_t thin = 0;
+        for (size_t j = 0; j < sizeof(sizes) / sizeof(sizes[0]); j++)
+        {
+            char command[32];
+            snprintf(command, sizeof(command), "setpensize %d", sizes[j]);
+            evaluate(command);
+            int64_t elapsed = time_program(programs[i]);
+            thin = j ? thin : elapsed;
+            int64_t ratio = elapsed * 100 / (thin ? thin : 1);
+            printf("%s, pen %d: %lld ms, %lld.%02lldx\n", programs[i], sizes[j], (long long)elapsed / 1000,
+                   (long long)ratio / 100, (long long)ratio % 100);
+        }
+    }
+    evaluate("setpensize 1");
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Check that wide pens set exactly the pixels whose centres are within half
+// the pen width of the line, for strokes of random widths, some of them
+// shorter than the pen is wide
+void pen_test(void)
+{
+    uint16_t *frame = screen_gfx_frame();
+    uint32_t seed = 9;
+    uint32_t extra = 0;
+    uint32_t missing = 0;
+    const int count = 300;
+
+    for (int i = 0; i < count; i++)
+    {
+        float x1 = seeded_random(&seed, 20.0f, SCREEN_WIDTH - 20);
+        float y1 = seeded_random(&seed, 20.0f, SCREEN_HEIGHT - 20);
+        float x2 = seeded_random(&seed, 20.0f, SCREEN_WIDTH - 20);
+        float y2 = seeded_random(&seed, 20.0f, SCREEN_HEIGHT - 20);
+        int width = 2 + (int)seeded_random(&seed, 0.0f, TURTLE_PEN_SIZE_MAX - 1);
+        if (i % 3 == 0)
+        {
+            x2 = x1 + seeded_random(&seed, -3.0f, 3.0f);
+            y2 = y1 + seeded_random(&seed, -3.0f, 3.0f);
+        }
+
+        screen_gfx_clear();
+        screen_gfx_stroke(x1, y1, x2, y2, width, COLOUR_WHITE);
+        screen_gfx_fence();
+
+        // Pixels within 0.01 of the edge could go either way. Only those
+        // near the stroke need the distance worked out.
+        float half = width / 2.0f;
+        float left = fminf(x1, x2) - half - 1.0f;
+        float right = fmaxf(x1, x2) + half + 1.0f;
+        float top = fminf(y1, y2) - half - 1.0f;
+        float bottom = fmaxf(y1, y2) + half + 1.0f;
+        for (int y = 0; y < SCREEN_HEIGHT; y++)
+        {
+            for (int x = 0; x < SCREEN_WIDTH; x++)
+            {
+                bool set = frame[y * SCREEN_WIDTH + x] != 0;
+                if (x < left || x > right || y < top || y > bottom)
+                {
+                    extra += set;
+                    continue;
+                }
+                float distance = segment_distance(x, y, x1, y1, x2, y2);
+                extra += set && distance > half + 0.01f;
+                missing += !set && distance < half - 0.01f;
+            }
+        }
+    }
+    printf("Pen strokes: %s (%lu pixels extra, %lu missing, %d strokes)\n", extra || missing ? "fail" : "pass",
+           (unsigned long)extra, (unsigned long)missing, count);
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Time the same drawings with aliased and anti-aliased lines on this chip,
+// and how long core 1 spent drawing each
+void smooth_benchmark(void)
+{
+#if PICO_RP2350
+    const char *chip = "RP2350";
+#else
+    const char *chip = "RP2040";
+#endif
+    const char *programs[] = {
+        "cs ht repeat 360 [fd 150 bk 150 rt 1]",
+        "cs ht repeat 10 [repeat 360 [fd 2 rt 1] rt 36]",
+    };
+
+    for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++)
+    {
+        uint32_t drawing[2], waiting;
+        int64_t elapsed[2];
+        for (int smooth = 0; smooth < 2; smooth++)
+        {
+            turtle_set_smooth(smooth);
+            screen_gfx_fence();
+            screen_gfx_times(&drawing[smooth], &waiting);
+            elapsed[smooth] = time_program(programs[i]);
+            screen_gfx_times(&drawing[smooth], &waiting);
+        }
+        uint32_t ratio = drawing[1] * 100 / (drawing[0] ? drawing[0] : 1);
+        printf("%s: %s\n", chip, programs[i]);
+        printf("  aliased %lld ms, drawing %lu us\n", (long long)elapsed[0] / 1000, (unsigned long)drawing[0]);
+        printf("  smooth %lld ms, drawing %lu us, %lu.%02lux\n", (long long)elapsed[1] / 1000,
+               (unsigned long)drawing[1], (unsigned long)ratio / 100, (unsigned long)ratio % 100);
+    }
+    turtle_set_smooth(false);
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Time a drawing as it runs while it is recorded, against replaying the
+// picture it recorded
+void picture_benchmark(void)
+{
+    const char *program = "cs ht repeat 36 [repeat 10 [fd 40 rt 36] rt 10]"; // Fits in the picture on an RP2040
+
+    evaluate("record");
+    int64_t running = time_program(program);
+    evaluate("norecord");
+
+    absolute_time_t start_time = get_absolute_time();
+    int result = picture_replay();
+    screen_gfx_fence();
+    int64_t replaying = absolute_time_diff_us(start_time, get_absolute_time());
+
+    int64_t ratio = running * 100 / (replaying ? replaying : 1);
+    printf("%s\n", program);
+    printf("  running %lld ms, replaying %lld ms, %lld.%02lldx faster\n", (long long)running / 1000,
+           (long long)replaying / 1000, (long long)ratio / 100, (long long)ratio % 100);
+    if (result != PICTURE_OK)
+    {
+        printf("  replay failed: %d\n", result);
+    }
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Time the same walk with more and more turtles, each taking every step,
+// and count the updates each needs, which should not grow with the turtles.
+// Then check that ASK gives the turtles back after it finishes and after an
+// error.
+void swarm_benchmark(void)
+{
+    const char *program = "repeat 500 [fd 2 rt random 20]";
+
+    for (int count = 1; count <= TURTLE_COUNT; count *= 2)
+    {
+        // Spread the turtles out evenly around home, then tell them all
+        char command[96] = "tell [";
+        evaluate("tell 0 cs");
+        for (int t = 0; t < count; t++)
+        {
+            char spread[32];
+            snprintf(spread, sizeof(spread), "ask %d [rt %d]", t, t * 360 / count);
+            evaluate(spread);
+            snprintf(command + strlen(command), sizeof(command) - strlen(command), "%d ", t);
+        }
+        strncat(command, "]", sizeof(command) - strlen(command) - 1);
+        evaluate(command);
+
+        uint32_t frames, blits;
+        screen_gfx_fence();
+        screen_gfx_stats(&frames, &blits);
+        int64_t elapsed = time_program(program);
+        screen_gfx_stats(&frames, &blits);
+        printf("%d turtles: %lld ms, %lld us per turtle, %lu updates\n", count, (long long)elapsed / 1000,
+               (long long)elapsed / count, (unsigned long)frames);
+    }
+
+    evaluate("tell 0 ask [1 2] [fd 10]");
+    printf("Ask: %s\n", turtle_get_told() == 1 ? "pass" : "fail");
+    int state = evaluate("ask 1 [fd 10 fd [x]]");
+    printf("Ask error: %s\n", state == EVAL_STATE_ERROR && turtle_get_told() == 1 ? "pass" : "fail");
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Time circles drawn the usual Logo way, with REPEAT, against CIRCLE and
+// ARC, and the filled shapes
+void shape_benchmark(void)
+{
+    const char *programs[] = {
+        "cs ht repeat 20 [repeat 360 [fd 2 rt 1] rt 18]",
+        "cs ht repeat 20 [pu fd 114.6 pd circle 114.6 pu bk 114.6 rt 18]",
+        "cs ht repeat 20 [repeat 90 [fd 2 rt 1] rt 72]",
+        "cs ht repeat 20 [arc 90 114.6 rt 18]",
+        "cs ht repeat 20 [filledcircle 100 rt 18]",
+        "cs ht repeat 20 [filledellipse 150 60 rt 18]",
+    };
+
+    for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++)
+    {
+        int64_t elapsed = time_program(programs[i]);
+        printf("%s: %lld us\n", programs[i], (long long)elapsed);
+    }
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Check ellipses and arcs of random sizes around the middle of the screen.
+// Every pixel of an outline must be within a pixel of the true curve, and
+// every row it spans must have a pixel, so it has no gaps. A filled ellipse
+// must cover within 5% of its area, and an arc must stay within its angle.
+void shape_test(void)
+{
+    uint16_t *frame = screen_gfx_frame();
+    const float cx = SCREEN_WIDTH / 2;
+    const float cy = SCREEN_HEIGHT / 2;
+    uint32_t seed = 5;
+    uint32_t far = 0;
+    uint32_t gaps = 0;
+    uint32_t areas = 0;
+    uint32_t outside = 0;
+    const int count = 100;
+
+    for (int i = 0; i < count; i++)
+    {
+        int rx = (int)seeded_random(&seed, 0.0f, 140.0f);
+        int ry = i % 2 ? rx : (int)seeded_random(&seed, 0.0f, 140.0f);
+
+        screen_gfx_clear();
+        screen_gfx_ellipse(cx, cy, rx, ry, COLOUR_WHITE, false);
+        screen_gfx_fence();
+        for (int y = cy - ry; y <= cy + ry; y++)
+        {
+            bool row = false;
+            for (int x = 0; x < SCREEN_WIDTH; x++)
+            {
+                if (frame[y * SCREEN_WIDTH + x] && rx && ry)
+                {
+                    float dx = x - cx;
+                    float dy = y - cy;
+                    float off = fabsf(sqrtf(dx * dx / (rx * rx) + dy * dy / (ry * ry)) - 1.0f) * fminf(rx, ry);
+                    far += off > 1.0f;
+                }
+                row |= frame[y * SCREEN_WIDTH + x] != 0;
+            }
+            gaps += !row;
+        }
+
+        screen_gfx_clear();
+        screen_gfx_ellipse(cx, cy, rx, ry, COLOUR_WHITE, true);
+        screen_gfx_fence();
+        uint32_t area = 0;
+        for (int p = 0; p < SCREEN_WIDTH * SCREEN_HEIGHT; p++)
+        {
+            area += frame[p] != 0;
+        }
+        float ideal = (float)M_PI * (rx + 0.5f) * (ry + 0.5f);
+        areas += rx > 3 && ry > 3 && fabsf(area - ideal) > ideal * 0.05f;
+
+        // An arc from a heading, turning through an angle either way
+        float heading = (int)seeded_random(&seed, 0.0f, 360.0f);
+        float angle = (int)seeded_random(&seed, -360.0f, 360.0f);
+        screen_gfx_clear();
+        screen_gfx_arc(cx, cy, 100, heading, angle, COLOUR_WHITE);
+        screen_gfx_fence();
+        float start = angle < 0 ? heading + angle : heading;
+        float sweep = fabsf(angle);
+        for (int y = 0; y < SCREEN_HEIGHT; y++)
+        {
+            for (int x = 0; x < SCREEN_WIDTH; x++)
+            {
+                if (frame[y * SCREEN_WIDTH + x] && sweep < 360.0f)
+                {
+                    float direction = atan2f(x - cx, cy - y) * (float)(180.0 / M_PI);
+                    float along = fmodf(fmodf(direction - start, 360.0f) + 360.0f, 360.0f);
+                    outside += along > sweep + 1.0f && along < 359.0f;
+                }
+            }
+        }
+    }
+    screen_gfx_clear();
+    printf("Outlines: %s (%lu pixels too far, %lu rows missing)\n", far || gaps ? "fail" : "pass",
+           (unsigned long)far, (unsigned long)gaps);
+    printf("Filled areas: %s (%lu of %d off by more than 5%%)\n", areas ? "fail" : "pass", (unsigned long)areas,
+           count);
+    printf("Arcs: %s (%lu pixels outside the angle)\n", outside ? "fail" : "pass", (unsigned long)outside);
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Check that a flood fill too big for its stack stays in its own area. The
+// left of the screen is a comb of 150 teeth, which needs more runs waiting
+// than FILL_STACK holds. A wall cuts off the right, which has lines in the
+// fill colour on every other row, already next to the background.
+void fill_test(void)
+{
+    uint16_t *frame = screen_gfx_frame();
+
+    screen_gfx_clear();
+    for (int x = 1; x < 298; x += 2)
+    {
+        screen_gfx_line(x, 8, x, 311, COLOUR_WHITE, false);
+    }
+    screen_gfx_line(299, 0, 299, SCREEN_HEIGHT - 1, COLOUR_WHITE, false);
+    for (int y = 0; y < SCREEN_HEIGHT; y += 2)
+    {
+        screen_gfx_line(304, y, 316, y, COLOUR_RED, false);
+    }
+    screen_gfx_fence();
+
+    uint32_t before = 0;
+    for (int y = 0; y < SCREEN_HEIGHT; y++)
+    {
+        for (int x = 300; x < SCREEN_WIDTH; x++)
+        {
+            before = before * 31 + frame[y * SCREEN_WIDTH + x];
+        }
+    }
+
+    screen_gfx_fill(0, 100, COLOUR_RED);
+    screen_gfx_fence();
+
+    uint32_t after = 0;
+    uint32_t missed = 0;
+    for (int y = 0; y < SCREEN_HEIGHT; y++)
+    {
+        for (int x = 0; x < SCREEN_WIDTH; x++)
+        {
+            if (x >= 300)
+            {
+                after = after * 31 + frame[y * SCREEN_WIDTH + x];
+            }
+            else
+            {
+                missed += frame[y * SCREEN_WIDTH + x] == COLOUR_BLACK;
+            }
+        }
+    }
+    printf("Fill past the stack: %s (%lu pixels missed)\n", missed == 0 ? "pass" : "fail", (unsigned long)missed);
+    printf("Fill colour elsewhere: %s\n", before == after ? "pass" : "fail");
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Time flood fills and polygon fills, and count the pixels each changed
+void fill_benchmark(void)
+{
+    const char *programs[] = {
+        "cs ht fill",
+        "cs ht repeat 360 [fd 2 rt 1] pu rt 90 fd 40 fill",
+        "cs ht repeat 200 [fd 300 rt 179] pu home fill",
+        "cs ht pu bk 160 lt 90 fd 160 rt 90 beginfill repeat 2 [fd 240 rt 90 fd 320 rt 90] endfill",
+        "cs ht beginfill repeat 5 [fd 150 rt 144] endfill",
+        "cs ht beginfill repeat 120 [fd 5 rt 3] endfill",
+    };
+    uint16_t *frame = screen_gfx_frame();
+
+    for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++)
+    {
+        evaluate("cs");
+        screen_gfx_fence();
+        int64_t elapsed = time_program(programs[i]);
+
+        uint32_t pixels = 0;
+        for (int p = 0; p < SCREEN_WIDTH * SCREEN_HEIGHT; p++)
+        {
+            pixels += frame[p] != 0;
+        }
+        printf("%s: %lld us, %lu pixels\n", programs[i], (long long)elapsed, (unsigned long)pixels);
+    }
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Function to benchmark the interpreter
+// This runs the same commands typed one line at a time and inside a REPEAT,
+// and prints the number of commands per second for each
+void evaluate_benchmark(void)
+{
+    const int count = 10000;
+
+    absolute_time_t start_time = get_absolute_time();
+    for (int i = 0; i < count; i++)
+    {
+        evaluate("penup");
+    }
+    int64_t elapsed = absolute_time_diff_us(start_time, get_absolute_time());
+    printf("Line by line: %lld commands/s\n", (long long)count * 1000000 / (elapsed ? elapsed : 1));
+
+    start_time = get_absolute_time();
+    evaluate("repeat 10000 [penup]");
+    elapsed = absolute_time_diff_us(start_time, get_absolute_time());
+    printf("Repeat: %lld commands/s\n", (long long)count * 1000000 / (elapsed ? elapsed : 1));
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Check that tail-recursive procedures run in constant space and that deep
+// ordinary recursion stops with a Logo error instead of a crash
+void recursion_test(void)
+{
+    evaluate("to down :n");
+    evaluate("if lessp :n 1 [stop]");
+    evaluate("down difference :n 1");
+    evaluate("end");
+
+    absolute_time_t start_time = get_absolute_time();
+    int state = evaluate("down 1000000");
+    int64_t elapsed = absolute_time_diff_us(start_time, get_absolute_time());
+    printf("Tail calls: %s, %lld calls/s\n", state == EVAL_STATE_COMPLETE ? "pass" : last_error,
+           (long long)1000000 * 1000000 / (elapsed ? elapsed : 1));
+
+    evaluate("to depth :n");
+    evaluate("if lessp :n 1 [output 0]");
+    evaluate("output sum 1 depth difference :n 1");
+    evaluate("end");
+
+    state = evaluate("depth 1000000");
+    printf("Deep recursion: %s (%s)\n", state == EVAL_STATE_ERROR ? "pass" : "fail", last_error);
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Time a tight REPEAT loop to find the cost of polling for Break. Build
+// once as normal and once with -DVM_POLL_INTERVAL=0x7FFFFFFF (never poll)
+// and compare the two against the aim of under 1%, which has not been
+// measured yet. The fastest of several runs is reported, as a difference
+// that small is lost in the noise of one.
+void interrupt_benchmark(void)
+{
+    const int count = 1000000;
+    const int runs = 5;
+
+    int64_t fastest = INT64_MAX;
+    for (int run = 0; run < runs; run++)
+    {
+        absolute_time_t start_time = get_absolute_time();
+        evaluate("repeat 1000000 [penup]");
+        int64_t elapsed = absolute_time_diff_us(start_time, get_absolute_time());
+        fastest = elapsed < fastest ? elapsed : fastest;
+    }
+    printf("Poll interval %d: %lld ns per iteration, fastest of %d\n", VM_POLL_INTERVAL,
+           (long long)fastest * 1000 / count, runs);
+
+    printf("Press Break to stop an endless loop\n");
+    int state = evaluate("repeat 2000000000 [penup]");
+    printf("Break: %s\n", state == EVAL_STATE_ERROR ? last_error : "not pressed");
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Time the same arithmetic on whole numbers and on numbers with a fraction.
+// Whole numbers stay in integer registers; on the RP2040 the others go
+// through the soft-float library.
+void integer_benchmark(void)
+{
+    const int count = 100000;
+    const char *setup[] = {"make \"a 7 make \"b 3", "make \"a 7.5 make \"b 3.5"};
+    const char *names[] = {"Integer", "Float"};
+
+    for (int i = 0; i < 2; i++)
+    {
+        evaluate(setup[i]);
+        evaluate("make \"x 0");
+        absolute_time_t start_time = get_absolute_time();
+        evaluate("repeat 100000 [make \"x :a * repcount + :b - :x]");
+        int64_t elapsed = absolute_time_diff_us(start_time, get_absolute_time());
+        printf("%s: %lld ns per iteration\n", names[i], (long long)elapsed * 1000 / count);
+    }
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Check that closed shapes bring the turtle back to where it started, to
+// far less than a pixel, and that many tiny moves add up instead of being
+// lost. Then time moves along one heading, which need no trigonometry.
+void heading_test(void)
+{
+    const char *shapes[] = {
+        "cs repeat 4 [fd 100 rt 90]",
+        "cs repeat 6 [fd 100 rt 60]",
+        "cs repeat 3 [fd 100 lt 120]",
+        "cs repeat 8 [fd 60 rt 45]",
+        "cs repeat 5 [fd 150 rt 144]",
+        "cs repeat 36 [fd 25 rt 10]",
+        "cs repeat 1000 [fd 100 rt 90 fd 50 rt 90]",
+        "cs repeat 1000 [repeat 6 [fd 77 rt 60]]",
+    };
+
+    for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++)
+    {
+        float x, y;
+        evaluate(shapes[i]);
+        turtle_get_position(&x, &y);
+        bool closed = fabsf(x - TURTLE_HOME_X) < 0.001f && fabsf(y - TURTLE_HOME_Y) < 0.001f;
+        printf("%s: %s (%g, %g)\n", shapes[i], closed ? "pass" : "fail", x, y);
+    }
+
+    // 1000 moves of 0.0005 go half a pixel, less what a float near 160 loses
+    float x, y;
+    evaluate("cs pu repeat 1000 [fd 0.0005] pd");
+    turtle_get_position(&x, &y);
+    bool moved = x == TURTLE_HOME_X && TURTLE_HOME_Y - y > 0.45f && TURTLE_HOME_Y - y < 0.55f;
+    printf("Tiny moves: %s (%g, %g)\n", moved ? "pass" : "fail", x, y);
+
+    const int count = 100000;
+    evaluate("cs pu rt 37");
+    absolute_time_t start_time = get_absolute_time();
+    evaluate("repeat 100000 [fd 1]");
+    int64_t elapsed = absolute_time_diff_us(start_time, get_absolute_time());
+    printf("Moves: %lld ns per move\n", (long long)elapsed * 1000 / count);
+    evaluate("pd");
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Check that every float in a large sample prints with digits that read
+// back as the same float, then time printing against printf
+void number_test(void)
+{
+    const uint32_t step = 4099; // Prime, so the sample covers every exponent and mantissa pattern
+    uint32_t checked = 0;
+    uint32_t failed = 0;
+    char text[NUMBER_SIZE];
+
+    for (uint32_t bits = 0; bits < 0x7F800000u - step; bits += step)
+    {
+        float number, back;
+        memcpy(&number, &bits, sizeof(number));
+        uint16_t length = number_format(number, text);
+        if (!number_parse(text, length, &back) || back != number || strtof(text, NULL) != number)
+        {
+            if (failed++ < 10)
+            {
+                printf("Fail: %08lx printed as %s\n", (unsigned long)bits, text);
+            }
+        }
+        checked++;
+    }
+    printf("Round trip: %lu of %lu failed\n", (unsigned long)failed, (unsigned long)checked);
+
+    const int count = 10000;
+    absolute_time_t start_time = get_absolute_time();
+    for (int i = 0; i < count; i++)
+    {
+        number_format(i / 7.0f, text);
+    }
+    int64_t elapsed = absolute_time_diff_us(start_time, get_absolute_time());
+    printf("number_format: %lld ns per number\n", (long long)elapsed * 1000 / count);
+
+    start_time = get_absolute_time();
+    for (int i = 0; i < count; i++)
+    {
+        snprintf(text, sizeof(text), "%.9g", i / 7.0f);
+    }
+    elapsed = absolute_time_diff_us(start_time, get_absolute_time());
+    printf("snprintf: %lld ns per number\n", (long long)elapsed * 1000 / count);
+
+    start_time = get_absolute_time();
+    for (int i = 0; i < count; i++)
+    {
+        float number;
+        number_parse("3.14159", 7, &number);
+    }
+    elapsed = absolute_time_diff_us(start_time, get_absolute_time());
+    printf("number_parse: %lld ns per number\n", (long long)elapsed * 1000 / count);
+
+    start_time = get_absolute_time();
+    for (int i = 0; i < count; i++)
+    {
+        strtof("3.14159", NULL);
+    }
+    elapsed = absolute_time_diff_us(start_time, get_absolute_time());
+    printf("strtof: %lld ns per number\n", (long long)elapsed * 1000 / count);
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
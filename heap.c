@@ -0,0 +1,585 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+//
+//  Node heap
+//
+//  Lists, and words made while the program runs, are built from fixed-size
+//  nodes in a statically allocated array, so taking a node is a pop from a
+//  free list and never calls malloc. Numbers are held in the value itself
+//  and words that appear in the source are symbols, so neither uses nodes.
+//
+//  Unused nodes are found by mark and sweep. Every node is the same size,
+//  so the heap cannot fragment and there is nothing to gain by compacting.
+//  The collector runs only from heap_reserve, which a primitive calls once
+//  for all the nodes it will need before it starts building. Everything
+//  still in use at that point is reachable from a variable, a saved input
+//  binding or the VM stack, and the nodes a primitive takes afterwards
+//  cannot be collected from under it.
+//
+//  Marking follows the rest of a list in a loop and keeps the sublists it
+//  still has to visit on a small stack. If that stack overflows, the heap
+//  is scanned for marked nodes with unmarked sublists until none are left,
+//  so the C stack never grows with the depth of a list.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "pico/stdlib.h"
+
+#include "evaluate.h"
+#include "heap.h"
+#include "number.h"
+#include "symbols.h"
+#include "vm.h"
+
+_Static_assert(HEAP_NODES < HEAP_NIL, "HEAP_NODES must fit in a 16-bit index");
+
+node_t heap_nodes[HEAP_NODES];               // The nodes
+static uint16_t free_list = HEAP_NIL;        // First free node that has been used before
+static uint16_t fresh = 0;                   // Nodes above this have never been used
+static uint16_t free_count = HEAP_NODES;     // Number of free nodes
+static uint16_t peak = 0;                    // Most nodes in use since heap_stats was called
+static uint16_t mark_stack[HEAP_MARK_STACK]; // Sublists waiting to be marked
+static uint8_t mark_depth = 0;               // Number of sublists waiting
+static bool mark_overflow = false;           // True if a sublist did not fit on the stack
+static char text_a[HEAP_WORD_MAX + 1];       // Scratch space for comparing words
+static char text_b[HEAP_WORD_MAX + 1];       // Scratch space for comparing words
+
+// Where value_format writes: a buffer, or stdout if the buffer is NULL
+typedef struct
+{
+    char *buffer;    // Destination
+    uint16_t size;   // Size of the destination
+    uint16_t length; // Characters written so far
+} sink_t;
+
+//
+//  Helper functions
+//
+
+// Take a node from the free list. The caller has reserved it.
+static uint16_t alloc(uint8_t type)
+{
+    uint16_t node;
+    if (free_list != HEAP_NIL)
+    {
+        node = free_list;
+        free_list = heap_nodes[node].rest;
+    }
+    else
+    {
+        node = fresh++;
+    }
+    free_count--;
+    if (HEAP_NODES - free_count > peak)
+    {
+        peak = HEAP_NODES - free_count;
+    }
+    heap_nodes[node].type = type;
+    heap_nodes[node].rest = HEAP_NIL;
+    heap_nodes[node].marked = false;
+    return node;
+}
+
+// Mark a chain of nodes, queuing any sublists
+static void mark_chain(uint16_t node)
+{
+    while (node != HEAP_NIL && !heap_nodes[node].marked)
+    {
+        node_t *n = &heap_nodes[node];
+        n->marked = true;
+        if (n->type == NODE_LIST && n->first.type >= VALUE_TEXT &&
+            n->first.node != HEAP_NIL && !heap_nodes[n->first.node].marked)
+        {
+            if (mark_depth < HEAP_MARK_STACK)
+            {
+                mark_stack[mark_depth++] = n->first.node;
+            }
+            else
+            {
+                mark_overflow = true;
+            }
+        }
+        node = n->rest;
+    }
+}
+
+// Mark every queued sublist
+static void mark_queued(void)
+{
+    while (mark_depth)
+    {
+        mark_chain(mark_stack[--mark_depth]);
+    }
+}
+
+// Write text to a sink
+static void put(sink_t *sink, const char *text, uint16_t length)
+{
+    if (!sink->buffer)
+    {
+        fwrite(text, 1, length, stdout);
+    }
+    else if (sink->length + 1 < sink->size)
+    {
+        uint16_t room = sink->size - 1 - sink->length;
+        if (length > room)
+        {
+            length = room;
+        }
+        memcpy(sink->buffer + sink->length, text, length);
+        sink->buffer[sink->length + length] = '\0';
+    }
+    sink->length += length;
+}
+
+// Write a value to a sink
+static void format(sink_t *sink, value_t value, bool brackets, int depth)
+{
+    switch (value.type)
+    {
+    case VALUE_NUMBER:
+    {
+        char number[NUMBER_SIZE];
+        put(sink, number, number_format(value.number, number));
+        break;
+    }
+
+    case VALUE_INTEGER:
+    {
+        char number[NUMBER_SIZE];
+        put(sink, number, number_format_integer(value.integer, number));
+        break;
+    }
+
+    case VALUE_WORD:
+    {
+        const symbol_t *symbol = symbol_get(value.symbol);
+        put(sink, symbol->name, symbol->length);
+        break;
+    }
+
+    case VALUE_TEXT:
+        for (uint16_t node = value.node; node != HEAP_NIL; node = heap_nodes[node].rest)
+        {
+            put(sink, heap_nodes[node].text, strnlen(heap_nodes[node].text, HEAP_TEXT_SIZE));
+        }
+        break;
+
+    case VALUE_LIST:
+        if (depth == HEAP_RECURSION)
+        {
+            put(sink, "...", 3);
+            break;
+        }
+        if (brackets)
+        {
+            put(sink, "[", 1);
+        }
+        for (uint16_t node = value.node; node != HEAP_NIL; node = heap_nodes[node].rest)
+        {
+            format(sink, heap_nodes[node].first, true, depth + 1);
+            if (heap_nodes[node].rest != HEAP_NIL)
+            {
+                put(sink, " ", 1);
+            }
+        }
+        if (brackets)
+        {
+            put(sink, "]", 1);
+        }
+        break;
+    }
+}
+
+// Compare two lists element by element
+static bool lists_equal(uint16_t a, uint16_t b, int depth)
+{
+    while (a != HEAP_NIL && b != HEAP_NIL)
+    {
+        value_t x = heap_nodes[a].first;
+        value_t y = heap_nodes[b].first;
+        if (x.type == VALUE_LIST && y.type == VALUE_LIST)
+        {
+            // Lists nested too deeply to walk are only equal if they are the same list
+            if (depth == HEAP_RECURSION ? x.node != y.node : !lists_equal(x.node, y.node, depth + 1))
+            {
+                return false;
+            }
+        }
+        else if (!value_equal(x, y))
+        {
+            return false;
+        }
+        a = heap_nodes[a].rest;
+        b = heap_nodes[b].rest;
+    }
+    return a == b;
+}
+
+//
+//  Heap functions
+//
+
+// Make sure there are at least count free nodes, collecting if there are
+// not. Sets the error and returns false if the heap is full.
+bool heap_reserve(uint16_t count)
+{
+    if (free_count >= count)
+    {
+        return true;
+    }
+    heap_collect();
+    if (free_count >= count)
+    {
+        return true;
+    }
+    evaluate_error("Out of space");
+    return false;
+}
+
+// Add an element to the front of a list, giving the new first node.
+// The node must have been reserved.
+uint16_t heap_cons(value_t first, uint16_t rest)
+{
+    uint16_t node = alloc(NODE_LIST);
+    heap_nodes[node].first = first;
+    heap_nodes[node].rest = rest;
+    return node;
+}
+
+// Make a word from text. heap_text_nodes(length) nodes must have been reserved.
+value_t heap_word(const char *text, uint16_t length)
+{
+    value_t word = {.type = VALUE_TEXT, .node = HEAP_NIL};
+    uint16_t last = HEAP_NIL;
+
+    while (length)
+    {
+        uint16_t part = length < HEAP_TEXT_SIZE ? length : HEAP_TEXT_SIZE;
+        uint16_t node = alloc(NODE_TEXT);
+        memset(heap_nodes[node].text, 0, HEAP_TEXT_SIZE);
+        memcpy(heap_nodes[node].text, text, part);
+        if (last == HEAP_NIL)
+        {
+            word.node = node;
+        }
+        else
+        {
+            heap_nodes[last].rest = node;
+        }
+        last = node;
+        text += part;
+        length -= part;
+    }
+    return word;
+}
+
+// Build a list from the text between a pair of brackets. Words in the list
+// are interned as symbols, and brackets inside make sublists.
+bool heap_parse_list(const char *text, uint16_t length, value_t *list)
+{
+    const char *end = text + length;
+
+    // Count the elements at every level so they can be reserved at once
+    uint16_t count = 0;
+    for (const char *p = text; p < end;)
+    {
+        if (*p == ' ' || *p == '\t' || *p == '\n' || *p == ']')
+        {
+            p++;
+            continue;
+        }
+        count++;
+        if (*p == '[')
+        {
+            p++;
+            continue;
+        }
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\n' && *p != '[' && *p != ']')
+        {
+            p++;
+        }
+    }
+    if (!heap_reserve(count))
+    {
+        return false;
+    }
+
+    // Build each level front to back, remembering the last node of each
+    uint16_t first[HEAP_NESTING];
+    uint16_t last[HEAP_NESTING];
+    int level = 0;
+    first[0] = last[0] = HEAP_NIL;
+
+    for (const char *p = text; p <= end; p++)
+    {
+        value_t element;
+        if (p == end || *p == ']')
+        {
+            if (level == 0)
+            {
+                break;
+            }
+            element = value_list(first[level--]);
+        }
+        else if (*p == '[')
+        {
+            if (++level == HEAP_NESTING)
+            {
+                evaluate_error("List nested too deeply");
+                return false;
+            }
+            first[level] = last[level] = HEAP_NIL;
+            continue;
+        }
+        else if (*p == ' ' || *p == '\t' || *p == '\n')
+        {
+            continue;
+        }
+        else
+        {
+            const char *start = p;
+            while (p < end && *p != ' ' && *p != '\t' && *p != '\n' && *p != '[' && *p != ']')
+            {
+                p++;
+            }
+            symbol_t *symbol = symbol_intern(start, p - start);
+            if (!symbol)
+            {
+                evaluate_error("Out of space for words");
+                return false;
+            }
+            element = value_word(symbol_id(symbol));
+            p--;
+        }
+
+        uint16_t node = heap_cons(element, HEAP_NIL);
+        if (last[level] == HEAP_NIL)
+        {
+            first[level] = node;
+        }
+        else
+        {
+            heap_nodes[last[level]].rest = node;
+        }
+        last[level] = node;
+    }
+
+    *list = value_list(first[0]);
+    return true;
+}
+
+// Mark the nodes of a value as in use
+void heap_mark(value_t value)
+{
+    if (value.type >= VALUE_TEXT && value.node != HEAP_NIL)
+    {
+        mark_chain(value.node);
+        mark_queued();
+    }
+}
+
+// Free every node that is no longer reachable
+void heap_collect(void)
+{
+    // Mark from the variables, the saved bindings and the VM stack
+    uint16_t entries;
+    symbols_stats(&entries, NULL);
+    for (uint16_t id = 0; id < entries; id++)
+    {
+        const symbol_t *symbol = symbol_get(id);
+        if (symbol->bound)
+        {
+            heap_mark(symbol->value);
+        }
+    }
+    vm_mark_roots();
+
+    // Pick up the sublists that did not fit on the mark stack
+    while (mark_overflow)
+    {
+        mark_overflow = false;
+        for (uint16_t node = 0; node < fresh; node++)
+        {
+            const node_t *n = &heap_nodes[node];
+            if (n->marked && n->type == NODE_LIST && n->first.type >= VALUE_TEXT)
+            {
+                heap_mark(n->first);
+            }
+        }
+    }
+
+    // Sweep, rebuilding the free list in address order
+    free_list = HEAP_NIL;
+    free_count = HEAP_NODES - fresh;
+    for (uint16_t node = fresh; node-- > 0;)
+    {
+        node_t *n = &heap_nodes[node];
+        if (n->marked)
+        {
+            n->marked = false;
+        }
+        else
+        {
+            n->type = NODE_FREE;
+            n->rest = free_list;
+            free_list = node;
+            free_count++;
+        }
+    }
+}
+
+// Report the nodes in use now and the most in use since the last report
+void heap_stats(uint16_t *used, uint16_t *most)
+{
+    *used = HEAP_NODES - free_count;
+    *most = peak;
+    peak = *used;
+}
+
+//
+//  Value functions
+//
+
+// Copy the text of a word into a buffer, NUL terminated and truncated to
+// fit. Returns the length of the text, or 0 for a list.
+uint16_t value_text(value_t value, char *buffer, uint16_t size)
+{
+    buffer[0] = '\0';
+    if (value.type == VALUE_LIST)
+    {
+        return 0;
+    }
+    sink_t sink = {buffer, size, 0};
+    format(&sink, value, false, 0);
+    return sink.length < size ? sink.length : size - 1;
+}
+
+// Get the number a value stands for, if it is a number or a word like 42
+bool value_to_number(value_t value, float *number)
+{
+    if (value.type == VALUE_NUMBER)
+    {
+        *number = value.number;
+        return true;
+    }
+    if (value.type == VALUE_INTEGER)
+    {
+        *number = (float)value.integer;
+        return true;
+    }
+    if (value.type == VALUE_LIST)
+    {
+        return false;
+    }
+
+    char text[32];
+    uint16_t length = value_text(value, text, sizeof(text));
+    if (length == 0 || length == sizeof(text) - 1)
+    {
+        return false;
+    }
+    return number_parse(text, length, number);
+}
+
+// Get the whole number a value stands for, dropping any fraction
+bool value_to_integer(value_t value, int32_t *integer)
+{
+    if (value.type == VALUE_INTEGER)
+    {
+        *integer = value.integer;
+        return true;
+    }
+    float number;
+    if (!value_to_number(value, &number) || !(number > (float)INT32_MIN && number < (float)INT32_MAX))
+    {
+        return false;
+    }
+    *integer = (int32_t)number;
+    return true;
+}
+
+// Get the truth of a value, which must be the word true or false
+bool value_to_bool(value_t value, bool *truth)
+{
+    if (value.type == VALUE_WORD)
+    {
+        *truth = value.symbol == SYMBOL_TRUE;
+        return value.symbol == SYMBOL_TRUE || value.symbol == SYMBOL_FALSE;
+    }
+    if (value.type == VALUE_TEXT)
+    {
+        char text[8];
+        value_text(value, text, sizeof(text));
+        *truth = strcasecmp(text, "true") == 0;
+        return *truth || strcasecmp(text, "false") == 0;
+    }
+    return false;
+}
+
+// Make the word true or false
+value_t value_bool(bool truth)
+{
+    return value_word(truth ? SYMBOL_TRUE : SYMBOL_FALSE);
+}
+
+// Check if two values are equal: numbers by value, words ignoring case and
+// lists element by element
+bool value_equal(value_t a, value_t b)
+{
+    if (a.type == VALUE_LIST || b.type == VALUE_LIST)
+    {
+        return a.type == b.type && lists_equal(a.node, b.node, 0);
+    }
+    if (a.type == VALUE_WORD && b.type == VALUE_WORD && a.symbol == b.symbol)
+    {
+        return true;
+    }
+
+    if (a.type == VALUE_INTEGER && b.type == VALUE_INTEGER)
+    {
+        return a.integer == b.integer;
+    }
+    float x, y;
+    if (value_to_number(a, &x) && value_to_number(b, &y))
+    {
+        return x == y;
+    }
+
+    value_text(a, text_a, sizeof(text_a));
+    value_text(b, text_b, sizeof(text_b));
+    return strcasecmp(text_a, text_b) == 0;
+}
+
+// Write a value into a buffer as PRINT (brackets false) or SHOW would.
+// Returns the full length, which may be more than fits.
+uint16_t value_format(value_t value, char *buffer, uint16_t size, bool brackets)
+{
+    sink_t sink = {buffer, size, 0};
+    buffer[0] = '\0';
+    format(&sink, value, brackets, 0);
+    return sink.length;
+}
+
+// Print a value as PRINT (brackets false) or SHOW would, without a newline
+void value_print(value_t value, bool brackets)
+{
+    sink_t sink = {NULL, 0, 0};
+    format(&sink, value, brackets, 0);
+}
+
+// Set the error for a primitive that was given an input it cannot use
+int value_error(const char *name, value_t value)
+{
+    char text[64];
+    value_format(value, text, sizeof(text), true);
+    return evaluate_error("%s doesn't like %s as input", name, text);
+}
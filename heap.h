@@ -0,0 +1,115 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+// Heap limits, override from CMake to size the heap for the board
+#ifndef HEAP_NODES
+#define HEAP_NODES (4096) // Number of nodes for lists and words
+#endif
+#define HEAP_NIL (0xFFFF)    // Node index of the empty list
+#define HEAP_TEXT_SIZE (8)   // Characters of a word held by one node
+#define HEAP_WORD_MAX (255)  // Longest word that can be made while running
+#define HEAP_NESTING (32)    // Deepest nesting of a list written in brackets
+#define HEAP_MARK_STACK (64) // Sublists waiting to be marked before a rescan is needed
+#define HEAP_RECURSION (8)   // Deepest nesting walked recursively when printing or comparing
+
+// Value types
+#define VALUE_NUMBER (0)  // A number with a fraction, or too big for an integer
+#define VALUE_INTEGER (1) // A whole number
+#define VALUE_WORD (2)    // A word in the symbol table
+#define VALUE_TEXT (3)    // A word made while running, held in heap nodes
+#define VALUE_LIST (4)    // A list, HEAP_NIL if empty
+
+// Node types
+#define NODE_FREE (0) // On the free list
+#define NODE_LIST (1) // An element of a list
+#define NODE_TEXT (2) // Part of the text of a word
+
+// A Logo value
+typedef struct
+{
+    uint8_t type; // One of VALUE_*
+    union
+    {
+        float number;    // Value of a VALUE_NUMBER
+        int32_t integer; // Value of a VALUE_INTEGER
+        uint16_t symbol; // Symbol id of a VALUE_WORD
+        uint16_t node;   // First node of a VALUE_TEXT or VALUE_LIST
+    };
+} value_t;
+
+// A heap node: one element of a list, or up to 8 characters of a word
+typedef struct
+{
+    union
+    {
+        value_t first;             // The element, in a NODE_LIST
+        char text[HEAP_TEXT_SIZE]; // The characters, NUL padded, in a NODE_TEXT
+    };
+    uint16_t rest;  // Next node, or HEAP_NIL
+    uint8_t type;   // One of NODE_*
+    uint8_t marked; // Set by the collector on nodes in use
+} node_t;
+
+extern node_t heap_nodes[HEAP_NODES];
+
+// Make a number value
+static inline value_t value_number(float number)
+{
+    return (value_t){.type = VALUE_NUMBER, .number = number};
+}
+
+// Make a whole number value
+static inline value_t value_integer(int32_t integer)
+{
+    return (value_t){.type = VALUE_INTEGER, .integer = integer};
+}
+
+// Make a word value from a symbol id
+static inline value_t value_word(uint16_t symbol)
+{
+    return (value_t){.type = VALUE_WORD, .symbol = symbol};
+}
+
+// Make a list value from its first node
+static inline value_t value_list(uint16_t node)
+{
+    return (value_t){.type = VALUE_LIST, .node = node};
+}
+
+// Check if a value is a word (numbers are words too)
+static inline bool value_is_word(value_t value)
+{
+    return value.type != VALUE_LIST;
+}
+
+// Number of nodes needed to hold a word of the given length
+static inline uint16_t heap_text_nodes(uint16_t length)
+{
+    return (length + HEAP_TEXT_SIZE - 1) / HEAP_TEXT_SIZE;
+}
+
+// Function prototypes
+bool heap_reserve(uint16_t count);
+uint16_t heap_cons(value_t first, uint16_t rest);
+value_t heap_word(const char *text, uint16_t length);
+bool heap_parse_list(const char *text, uint16_t length, value_t *list);
+void heap_mark(value_t value);
+void heap_collect(void);
+void heap_stats(uint16_t *used, uint16_t *most);
+
+uint16_t value_text(value_t value, char *buffer, uint16_t size);
+bool value_to_number(value_t value, float *number);
+bool value_to_integer(value_t value, int32_t *integer);
+bool value_to_bool(value_t value, bool *truth);
+value_t value_bool(bool truth);
+bool value_equal(value_t a, value_t b);
+uint16_t value_format(value_t value, char *buffer, uint16_t size, bool brackets);
+void value_print(value_t value, bool brackets);
+int value_error(const char *name, value_t value);
@@ -0,0 +1,271 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+//
+//  Logo lexer
+//
+//  Splits a line of Logo into tokens without copying or modifying the source.
+//  Numbers are converted once, here, so the compiler and the VM never see
+//  the digits again.
+//
+
+#include <ctype.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "lexer.h"
+#include "number.h"
+
+//
+//  Helper functions
+//
+
+// Characters that always end a word
+static bool is_delimiter(char c)
+{
+    return c == '\0' || isspace((unsigned char)c) ||
+           c == '[' || c == ']' || c == '(' || c == ')';
+}
+
+// Characters that are infix operators
+static bool is_operator(char c)
+{
+    return c == '+' || c == '-' || c == '*' || c == '/' ||
+           c == '=' || c == '<' || c == '>';
+}
+
+// Scan a number starting at p, returning a pointer past the end of it, or
+// NULL if p does not start a number that runs all the way to a delimiter.
+// A number with no fraction or exponent that fits in 32 bits is whole.
+static const char *scan_number(const char *p, token_t *token)
+{
+    const char *start = p;
+    uint32_t whole = 0;
+    token->whole = true;
+
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && isxdigit((unsigned char)p[2]))
+    {
+        // Hexadecimal, handy for RGB565 colours (e.g. 0xF800)
+        uint32_t hex = 0;
+        for (p += 2; isxdigit((unsigned char)*p); p++)
+        {
+            uint32_t digit = isdigit((unsigned char)*p) ? *p - '0' : (tolower((unsigned char)*p) - 'a' + 10);
+            token->whole = token->whole && hex <= (INT32_MAX - digit) / 16;
+            hex = hex * 16 + digit;
+        }
+        if (!is_delimiter(*p) && !is_operator(*p))
+        {
+            return NULL;
+        }
+        token->number = (float)hex;
+        token->integer = (int32_t)hex;
+        return p;
+    }
+
+    bool digits = false;
+    while (isdigit((unsigned char)*p))
+    {
+        uint32_t digit = *p - '0';
+        token->whole = token->whole && whole <= (INT32_MAX - digit) / 10;
+        whole = whole * 10 + digit;
+        p++;
+        digits = true;
+    }
+    if (*p == '.')
+    {
+        token->whole = false;
+        p++;
+        while (isdigit((unsigned char)*p))
+        {
+            p++;
+            digits = true;
+        }
+    }
+    if (!digits)
+    {
+        return NULL;
+    }
+    if (*p == 'e' || *p == 'E')
+    {
+        const char *exponent = p + 1;
+        if (*exponent == '+' || *exponent == '-')
+        {
+            exponent++;
+        }
+        if (isdigit((unsigned char)*exponent))
+        {
+            token->whole = false;
+            p = exponent;
+            while (isdigit((unsigned char)*p))
+            {
+                p++;
+            }
+        }
+    }
+    if (!is_delimiter(*p) && !is_operator(*p))
+    {
+        return NULL; // Something like 3d is a word, not a number
+    }
+
+    number_parse(start, p - start, &token->number);
+    token->integer = (int32_t)whole;
+    return p;
+}
+
+// Scan the next token from the source
+static void scan(lexer_t *lexer, bool after_space, uint8_t previous, token_t *token)
+{
+    const char *p = lexer->next;
+
+    token->number = 0.0f;
+    token->integer = 0;
+    token->whole = false;
+
+    if (*p == '\0')
+    {
+        token->type = TOKEN_END;
+        token->text = p;
+        token->length = 0;
+        return;
+    }
+
+    const char *start = p;
+    switch (*p)
+    {
+    case '[':
+        token->type = TOKEN_LEFT_BRACKET;
+        p++;
+        break;
+    case ']':
+        token->type = TOKEN_RIGHT_BRACKET;
+        p++;
+        break;
+    case '(':
+        token->type = TOKEN_LEFT_PAREN;
+        p++;
+        break;
+    case ')':
+        token->type = TOKEN_RIGHT_PAREN;
+        p++;
+        break;
+    case '"':
+        // A quoted word runs to whitespace or a bracket
+        token->type = TOKEN_QUOTED;
+        start = ++p;
+        while (!is_delimiter(*p))
+        {
+            p++;
+        }
+        break;
+    case ':':
+        // A variable name also stops at an infix operator
+        token->type = TOKEN_VARIABLE;
+        start = ++p;
+        while (!is_delimiter(*p) && !is_operator(*p))
+        {
+            p++;
+        }
+        break;
+    default:
+        if (is_operator(*p))
+        {
+            // A minus preceded by a space (or nothing) and followed by
+            // something other than a space is unary, e.g. fd -10 or -:size
+            bool unary = *p == '-' && !is_delimiter(p[1]) &&
+                         (after_space || previous == TOKEN_END ||
+                          previous == TOKEN_LEFT_BRACKET || previous == TOKEN_LEFT_PAREN ||
+                          previous == TOKEN_OPERATOR || previous == TOKEN_NEGATE);
+            if (unary)
+            {
+                const char *end = scan_number(p + 1, token);
+                if (end)
+                {
+                    token->type = TOKEN_NUMBER;
+                    token->number = -token->number;
+                    if (token->whole)
+                    {
+                        // Whole numbers fit in INT32_MAX, so this cannot overflow
+                        token->integer = -token->integer;
+                    }
+                    p = end;
+                    break;
+                }
+                token->type = TOKEN_NEGATE;
+                p++;
+                break;
+            }
+
+            token->type = TOKEN_OPERATOR;
+            if ((p[0] == '<' && (p[1] == '=' || p[1] == '>')) || (p[0] == '>' && p[1] == '='))
+            {
+                p++;
+            }
+            p++;
+            break;
+        }
+
+        const char *end = scan_number(p, token);
+        if (end)
+        {
+            token->type = TOKEN_NUMBER;
+            p = end;
+            break;
+        }
+
+        token->type = TOKEN_WORD;
+        while (!is_delimiter(*p) && !is_operator(*p))
+        {
+            p++;
+        }
+        break;
+    }
+
+    token->text = start;
+    token->length = (uint16_t)(p - start);
+    lexer->next = p;
+}
+
+// Skip whitespace, returning true if any was skipped
+static bool skip_space(lexer_t *lexer)
+{
+    const char *p = lexer->next;
+    while (isspace((unsigned char)*lexer->next))
+    {
+        lexer->next++;
+    }
+    return lexer->next != p;
+}
+
+//
+//  Lexer functions
+//
+
+// Start tokenizing the source text
+void lexer_init(lexer_t *lexer, const char *source)
+{
+    lexer->next = source;
+    bool space = skip_space(lexer);
+    scan(lexer, space, TOKEN_END, &lexer->peeked);
+}
+
+// Look at the next token without consuming it
+const token_t *lexer_peek(lexer_t *lexer)
+{
+    return &lexer->peeked;
+}
+
+// Consume and return the next token
+token_t lexer_next(lexer_t *lexer)
+{
+    token_t token = lexer->peeked;
+    if (token.type != TOKEN_END)
+    {
+        bool space = skip_space(lexer);
+        scan(lexer, space, token.type, &lexer->peeked);
+    }
+    return token;
+}
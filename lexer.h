@@ -0,0 +1,45 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+// Token types
+#define TOKEN_END (0)           // End of the input
+#define TOKEN_WORD (1)          // A bare word, e.g. forward
+#define TOKEN_NUMBER (2)        // A number, e.g. 3.14
+#define TOKEN_QUOTED (3)        // A quoted word, e.g. "hello
+#define TOKEN_VARIABLE (4)      // A variable reference, e.g. :size
+#define TOKEN_LEFT_BRACKET (5)  // Start of a list: [
+#define TOKEN_RIGHT_BRACKET (6) // End of a list: ]
+#define TOKEN_LEFT_PAREN (7)    // Start of a group: (
+#define TOKEN_RIGHT_PAREN (8)   // End of a group: )
+#define TOKEN_OPERATOR (9)      // Infix operator: + - * / = < > <= >= <>
+#define TOKEN_NEGATE (10)       // Unary minus, e.g. -:size
+
+// A token refers back into the source text, nothing is copied
+typedef struct
+{
+    uint8_t type;     // One of TOKEN_*
+    uint16_t length;  // Length of the token text
+    const char *text; // Start of the token text (after any " or : prefix)
+    float number;     // Value of a TOKEN_NUMBER
+    int32_t integer;  // Value of a TOKEN_NUMBER that is whole
+    bool whole;       // Whether a TOKEN_NUMBER was written without a fraction or exponent
+} token_t;
+
+// Lexer state with one token of lookahead
+typedef struct
+{
+    const char *next; // Next character to scan
+    token_t peeked;   // The lookahead token
+} lexer_t;
+
+// Function prototypes
+void lexer_init(lexer_t *lexer, const char *source);
+const token_t *lexer_peek(lexer_t *lexer);
+token_t lexer_next(lexer_t *lexer);
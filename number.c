@@ -0,0 +1,544 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+//
+//  Number conversion
+//
+//  PRINT writes a number with the fewest digits that read back as the same
+//  float, so 0.1 prints as 0.1 and 1/3 as 0.33333334, never 0.1000000015.
+//  The digits are found with the Ryu algorithm (Ulf Adams, 2018), which
+//  works in 32 and 64-bit integers from two small tables of powers of five
+//  and never touches floating point, so it costs the same on the RP2040
+//  as on the RP2350.
+//
+//  Reading a number does no locale or errno work. Up to 19 digits are
+//  gathered into an integer, and when that integer and the power of ten
+//  are both exact as floats, one multiply or divide gives the correctly
+//  rounded result. That covers nearly everything typed. Other numbers are
+//  worked out in double precision, falling back to strtof only when the
+//  double lands so close to halfway between two floats that rounding it
+//  again could go the wrong way.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "number.h"
+
+#define FLOAT_MANTISSA_BITS (23)     // Bits of mantissa stored in a float
+#define FLOAT_BIAS (127)             // Exponent bias of a float
+#define FLOAT_POW5_INV_BITCOUNT (59) // Precision of the reciprocal powers of five
+#define FLOAT_POW5_BITCOUNT (61)     // Precision of the powers of five
+#define NUMBER_DIGITS_MAX (19)       // Most significant digits gathered into an integer when reading
+
+// floor(2^(pow5_bits(q) - 1 + 59) / 5^q) + 1
+static const uint64_t pow5_inv_split[31] = {
+    576460752303423489u, 461168601842738791u, 368934881474191033u, 295147905179352826u,
+    472236648286964522u, 377789318629571618u, 302231454903657294u, 483570327845851670u,
+    386856262276681336u, 309485009821345069u, 495176015714152110u, 396140812571321688u,
+    316912650057057351u, 507060240091291761u, 405648192073033409u, 324518553658426727u,
+    519229685853482763u, 415383748682786211u, 332306998946228969u, 531691198313966350u,
+    425352958651173080u, 340282366920938464u, 544451787073501542u, 435561429658801234u,
+    348449143727040987u, 557518629963265579u, 446014903970612463u, 356811923176489971u,
+    570899077082383953u, 456719261665907162u, 365375409332725730u,
+};
+
+// 5^i scaled to 61 bits
+static const uint64_t pow5_split[47] = {
+    1152921504606846976u, 1441151880758558720u, 1801439850948198400u, 2251799813685248000u,
+    1407374883553280000u, 1759218604441600000u, 2199023255552000000u, 1374389534720000000u,
+    1717986918400000000u, 2147483648000000000u, 1342177280000000000u, 1677721600000000000u,
+    2097152000000000000u, 1310720000000000000u, 1638400000000000000u, 2048000000000000000u,
+    1280000000000000000u, 1600000000000000000u, 2000000000000000000u, 1250000000000000000u,
+    1562500000000000000u, 1953125000000000000u, 1220703125000000000u, 1525878906250000000u,
+    1907348632812500000u, 1192092895507812500u, 1490116119384765625u, 1862645149230957031u,
+    1164153218269348144u, 1455191522836685180u, 1818989403545856475u, 2273736754432320594u,
+    1421085471520200371u, 1776356839400250464u, 2220446049250313080u, 1387778780781445675u,
+    1734723475976807094u, 2168404344971008868u, 1355252715606880542u, 1694065894508600678u,
+    2117582368135750847u, 1323488980084844279u, 1654361225106055349u, 2067951531382569187u,
+    1292469707114105741u, 1615587133892632177u, 2019483917365790221u,
+};
+
+// Powers of ten that are exact as floats
+static const float float_powers[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+// Powers of ten that are exact as doubles
+static const double double_powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+//
+//  Helper functions
+//
+
+// Number of bits in 5^e, for e > 0
+static inline int32_t pow5_bits(int32_t e)
+{
+    return (int32_t)(((uint32_t)e * 1217359) >> 19) + 1;
+}
+
+// floor(log10(2^e))
+static inline uint32_t log10_pow2(int32_t e)
+{
+    return ((uint32_t)e * 78913) >> 18;
+}
+
+// floor(log10(5^e))
+static inline uint32_t log10_pow5(int32_t e)
+{
+    return ((uint32_t)e * 732923) >> 20;
+}
+
+// Check if a value is divisible by 5^p
+static bool multiple_of_pow5(uint32_t value, uint32_t p)
+{
+    uint32_t count = 0;
+    while (value % 5 == 0)
+    {
+        value /= 5;
+        count++;
+    }
+    return count >= p;
+}
+
+// Check if a value is divisible by 2^p
+static inline bool multiple_of_pow2(uint32_t value, uint32_t p)
+{
+    return (value & ((1u << p) - 1)) == 0;
+}
+
+// (m * factor) >> shift, for shift > 32
+static inline uint32_t mul_shift(uint32_t m, uint64_t factor, int32_t shift)
+{
+    uint64_t low = (uint64_t)m * (uint32_t)factor;
+    uint64_t high = (uint64_t)m * (uint32_t)(factor >> 32);
+    return (uint32_t)(((low >> 32) + high) >> (shift - 32));
+}
+
+// Find the shortest decimal digits and exponent that read back as the float
+// with the given stored mantissa and exponent
+static void shortest(uint32_t mantissa, uint32_t exponent, uint32_t *digits, int32_t *e10)
+{
+    int32_t e2;
+    uint32_t m2;
+    if (exponent == 0)
+    {
+        e2 = 1 - FLOAT_BIAS - FLOAT_MANTISSA_BITS - 2;
+        m2 = mantissa;
+    }
+    else
+    {
+        e2 = (int32_t)exponent - FLOAT_BIAS - FLOAT_MANTISSA_BITS - 2;
+        m2 = (1u << FLOAT_MANTISSA_BITS) | mantissa;
+    }
+    bool even = (m2 & 1) == 0;
+
+    // The float and the halfway points to its neighbours, times four
+    uint32_t mv = 4 * m2;
+    uint32_t mp = 4 * m2 + 2;
+    uint32_t mm_shift = mantissa != 0 || exponent <= 1;
+    uint32_t mm = 4 * m2 - 1 - mm_shift;
+
+    // Scale them to decimal, noting whether any digits dropped were zeros
+    uint32_t vr, vp, vm;
+    bool vm_trailing_zeros = false;
+    bool vr_trailing_zeros = false;
+    uint8_t last_removed = 0;
+    if (e2 >= 0)
+    {
+        uint32_t q = log10_pow2(e2);
+        *e10 = (int32_t)q;
+        int32_t k = FLOAT_POW5_INV_BITCOUNT + pow5_bits(q) - 1;
+        int32_t i = -e2 + (int32_t)q + k;
+        vr = mul_shift(mv, pow5_inv_split[q], i);
+        vp = mul_shift(mp, pow5_inv_split[q], i);
+        vm = mul_shift(mm, pow5_inv_split[q], i);
+        if (q != 0 && (vp - 1) / 10 <= vm / 10)
+        {
+            int32_t l = FLOAT_POW5_INV_BITCOUNT + pow5_bits(q - 1) - 1;
+            last_removed = mul_shift(mv, pow5_inv_split[q - 1], -e2 + (int32_t)q - 1 + l) % 10;
+        }
+        if (q <= 9)
+        {
+            if (mv % 5 == 0)
+            {
+                vr_trailing_zeros = multiple_of_pow5(mv, q);
+            }
+            else if (even)
+            {
+                vm_trailing_zeros = multiple_of_pow5(mm, q);
+            }
+            else
+            {
+                vp -= multiple_of_pow5(mp, q);
+            }
+        }
+    }
+    else
+    {
+        uint32_t q = log10_pow5(-e2);
+        *e10 = (int32_t)q + e2;
+        int32_t i = -e2 - (int32_t)q;
+        int32_t k = pow5_bits(i) - FLOAT_POW5_BITCOUNT;
+        int32_t j = (int32_t)q - k;
+        vr = mul_shift(mv, pow5_split[i], j);
+        vp = mul_shift(mp, pow5_split[i], j);
+        vm = mul_shift(mm, pow5_split[i], j);
+        if (q != 0 && (vp - 1) / 10 <= vm / 10)
+        {
+            j = (int32_t)q - 1 - (pow5_bits(i + 1) - FLOAT_POW5_BITCOUNT);
+            last_removed = mul_shift(mv, pow5_split[i + 1], j) % 10;
+        }
+        if (q <= 1)
+        {
+            vr_trailing_zeros = true;
+            if (even)
+            {
+                vm_trailing_zeros = mm_shift == 1;
+            }
+            else
+            {
+                vp--;
+            }
+        }
+        else if (q < 31)
+        {
+            vr_trailing_zeros = multiple_of_pow2(mv, q - 1);
+        }
+    }
+
+    // Drop digits while the neighbours' halfway points still differ
+    int32_t removed = 0;
+    if (vm_trailing_zeros || vr_trailing_zeros)
+    {
+        while (vp / 10 > vm / 10)
+        {
+            vm_trailing_zeros &= vm % 10 == 0;
+            vr_trailing_zeros &= last_removed == 0;
+            last_removed = vr % 10;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        if (vm_trailing_zeros)
+        {
+            while (vm % 10 == 0)
+            {
+                vr_trailing_zeros &= last_removed == 0;
+                last_removed = vr % 10;
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed++;
+            }
+        }
+        if (vr_trailing_zeros && last_removed == 5 && vr % 2 == 0)
+        {
+            last_removed = 4; // Round half to even
+        }
+        *digits = vr + ((vr == vm && (!even || !vm_trailing_zeros)) || last_removed >= 5);
+    }
+    else
+    {
+        while (vp / 10 > vm / 10)
+        {
+            last_removed = vr % 10;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        *digits = vr + (vr == vm || last_removed >= 5);
+    }
+    *e10 += removed;
+}
+
+// Check if a positive double is too close to halfway between two floats,
+// or too small, to be sure rounding it to float gives the right answer
+static bool near_halfway(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    int32_t low = (int32_t)(bits & ((1u << 29) - 1)) - (1 << 28);
+    return (low >= -16 && low <= 16) || value < 1.1754944e-38;
+}
+
+// Read a number with strtof, for the rare cases the fast paths cannot round
+static bool parse_slowly(const char *text, uint16_t length, float *number)
+{
+    char copy[64];
+    if (length >= sizeof(copy))
+    {
+        return false;
+    }
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    *number = strtof(copy, NULL);
+    return true;
+}
+
+// Write the decimal digits of a value, returning how many there were
+static uint16_t put_digits(uint32_t value, char *buffer)
+{
+    char reversed[10];
+    uint16_t length = 0;
+    do
+    {
+        reversed[length++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    for (uint16_t i = 0; i < length; i++)
+    {
+        buffer[i] = reversed[length - 1 - i];
+    }
+    return length;
+}
+
+//
+//  Number functions
+//
+
+// Write a float with the fewest digits that read back as the same value,
+// in the style of %g: 3, 0.25, 1.5e+20. The buffer must hold NUMBER_SIZE
+// characters. Returns the length.
+uint16_t number_format(float number, char *buffer)
+{
+    uint32_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    uint32_t mantissa = bits & ((1u << FLOAT_MANTISSA_BITS) - 1);
+    uint32_t exponent = (bits >> FLOAT_MANTISSA_BITS) & 0xFF;
+    bool negative = bits >> 31;
+
+    char *p = buffer;
+    if (negative)
+    {
+        *p++ = '-';
+    }
+    if (exponent == 0xFF)
+    {
+        if (mantissa)
+        {
+            p = buffer; // No sign on nan
+        }
+        memcpy(p, mantissa ? "nan" : "inf", 4);
+        return p + 3 - buffer;
+    }
+    if (exponent == 0 && mantissa == 0)
+    {
+        memcpy(p, "0", 2);
+        return p + 1 - buffer;
+    }
+
+    uint32_t value;
+    int32_t e10;
+    shortest(mantissa, exponent, &value, &e10);
+
+    char digits[10] = {0};
+    int32_t count = put_digits(value, digits);
+    int32_t point = count + e10; // Digits before the decimal point
+
+    if (point < -3 || point > 9)
+    {
+        // Scientific: d.ddde+XX
+        *p++ = digits[0];
+        if (count > 1)
+        {
+            *p++ = '.';
+            memcpy(p, digits + 1, count - 1);
+            p += count - 1;
+        }
+        int32_t power = point - 1;
+        *p++ = 'e';
+        *p++ = power < 0 ? '-' : '+';
+        if (power < 0)
+        {
+            power = -power;
+        }
+        if (power < 10)
+        {
+            *p++ = '0';
+        }
+        p += put_digits(power, p);
+    }
+    else if (point <= 0)
+    {
+        // Fraction: 0.000ddd
+        *p++ = '0';
+        *p++ = '.';
+        memset(p, '0', -point);
+        p += -point;
+        memcpy(p, digits, count);
+        p += count;
+    }
+    else if (point >= count)
+    {
+        // Whole: ddd000
+        memcpy(p, digits, count);
+        p += count;
+        memset(p, '0', point - count);
+        p += point - count;
+    }
+    else
+    {
+        // Both: ddd.ddd
+        memcpy(p, digits, point);
+        p += point;
+        *p++ = '.';
+        memcpy(p, digits + point, count - point);
+        p += count - point;
+    }
+    *p = '\0';
+    return p - buffer;
+}
+
+// Write a whole number. The buffer must hold NUMBER_SIZE characters.
+// Returns the length.
+uint16_t number_format_integer(int32_t integer, char *buffer)
+{
+    char *p = buffer;
+    uint32_t magnitude = (uint32_t)integer;
+    if (integer < 0)
+    {
+        *p++ = '-';
+        magnitude = -magnitude;
+    }
+    p += put_digits(magnitude, p);
+    *p = '\0';
+    return p - buffer;
+}
+
+// Read a decimal number such as 42, -3.5, .25 or 1e-3 that must fill the
+// whole of the text. Returns false if the text is not a number.
+bool number_parse(const char *text, uint16_t length, float *number)
+{
+    const char *p = text;
+    const char *end = text + length;
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p++ == '-';
+    }
+
+    // Gather the significant digits, counting those that did not fit
+    uint64_t digits = 0;
+    int32_t count = 0;
+    int32_t e10 = 0;
+    bool any = false;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        if (count < NUMBER_DIGITS_MAX)
+        {
+            digits = digits * 10 + (*p - '0');
+            count += digits != 0;
+        }
+        else
+        {
+            e10++;
+            count++;
+        }
+        p++;
+        any = true;
+    }
+    if (p < end && *p == '.')
+    {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            if (count < NUMBER_DIGITS_MAX)
+            {
+                digits = digits * 10 + (*p - '0');
+                count += digits != 0;
+                e10--;
+            }
+            else
+            {
+                count++;
+            }
+            p++;
+            any = true;
+        }
+    }
+    if (!any)
+    {
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        bool negative_exponent = false;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            negative_exponent = *p++ == '-';
+        }
+        if (p == end)
+        {
+            return false;
+        }
+        int32_t exponent = 0;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            if (exponent < 10000)
+            {
+                exponent = exponent * 10 + (*p - '0');
+            }
+            p++;
+        }
+        e10 += negative_exponent ? -exponent : exponent;
+    }
+    if (p != end)
+    {
+        return false;
+    }
+
+    float result;
+    if (digits == 0 || e10 < -64)
+    {
+        result = 0.0f; // Too small for a float
+    }
+    else if (e10 > 64)
+    {
+        result = __builtin_inff(); // Too large for a float
+    }
+    else if (count > NUMBER_DIGITS_MAX)
+    {
+        return parse_slowly(text, length, number); // Digits were dropped
+    }
+    else if (digits <= (1u << 24) && e10 >= -10 && e10 <= 10)
+    {
+        // Both are exact floats, so one operation rounds correctly
+        result = e10 < 0 ? (float)digits / float_powers[-e10] : (float)digits * float_powers[e10];
+    }
+    else
+    {
+        // Apply the power of ten in double precision, then round to float
+        // unless the few roundings on the way could have tipped it
+        double exact = (double)digits;
+        while (e10 > 22)
+        {
+            exact *= 1e22;
+            e10 -= 22;
+        }
+        while (e10 < -22)
+        {
+            exact /= 1e22;
+            e10 += 22;
+        }
+        exact = e10 < 0 ? exact / double_powers[-e10] : exact * double_powers[e10];
+        if (near_halfway(exact))
+        {
+            return parse_slowly(text, length, number);
+        }
+        result = (float)exact;
+    }
+
+    *number = negative ? -result : result;
+    return true;
+}
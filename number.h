@@ -0,0 +1,16 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#define NUMBER_SIZE (16) // Room for the longest number written by number_format, with its NUL
+
+// Function prototypes
+uint16_t number_format(float number, char *buffer);
+uint16_t number_format_integer(int32_t integer, char *buffer);
+bool number_parse(const char *text, uint16_t length, float *number);
@@ -7,19 +7,49 @@
 #include "stdio.h"
 #include "pico/stdlib.h"
 #include "pico/stdio/driver.h"
+#include "hardware/sync.h"
 
 #include "drivers/audio.h"
 #include "drivers/fat32.h"
 #include "drivers/keyboard.h"
 #include "drivers/southbridge.h"
 
+#include "picocalc.h"
 #include "screen.h"
 
-
 // Callback for when characters become available
 static void (*chars_available_callback)(void *) = NULL;
 static void *chars_available_param = NULL;
 
+// Keys taken from the keyboard driver but not yet read through stdio
+static char key_buffer[PICOCALC_KEY_BUFFER];
+static uint8_t key_head = 0; // Next slot to write
+static uint8_t key_tail = 0; // Next slot to read
+
+// Move keys from the keyboard driver into our buffer, turning Break and
+// Ctrl-C into a request to stop the running program. The keyboard calls
+// picocalc_chars_available_notify from its interrupt, so this is only
+// called with interrupts disabled.
+static void picocalc_take_keys(void)
+{
+    int c;
+    while ((c = keyboard_get_key()) != -1)
+    {
+        if (c == KEY_BREAK || c == KEY_CTRL_C)
+        {
+            user_interrupt = true;
+            continue;
+        }
+
+        uint8_t next = (key_head + 1) % PICOCALC_KEY_BUFFER;
+        if (next != key_tail)
+        {
+            key_buffer[key_head] = (char)c;
+            key_head = next;
+        }
+    }
+}
+
 static void picocalc_out_chars(const char *buf, int length)
 {
     for (int i = 0; i < length; ++i)
@@ -36,13 +66,14 @@ static void picocalc_out_flush(void)
 static int picocalc_in_chars(char *buf, int length)
 {
     int n = 0;
-    while (n < length)
+    uint32_t status = save_and_disable_interrupts();
+    picocalc_take_keys();
+    while (n < length && key_tail != key_head)
     {
-        int c = keyboard_get_key();
-        if (c == -1)
-            break; // No key pressed
-        buf[n++] = (char)c;
+        buf[n++] = key_buffer[key_tail];
+        key_tail = (key_tail + 1) % PICOCALC_KEY_BUFFER;
     }
+    restore_interrupts(status);
     return n;
 }
 
@@ -55,6 +86,10 @@ static void picocalc_set_chars_available_callback(void (*fn)(void *), void *para
 // Function to be called when characters become available
 void picocalc_chars_available_notify(void)
 {
+    uint32_t status = save_and_disable_interrupts();
+    picocalc_take_keys();
+    restore_interrupts(status);
+
     if (chars_available_callback)
     {
         chars_available_callback(chars_available_param);
@@ -8,5 +8,10 @@
 
 #include "pico/stdlib.h"
 
+#define PICOCALC_KEY_BUFFER (32) // Keys held between the keyboard driver and stdio
+#define KEY_CTRL_C (0x03)        // Ctrl-C, which stops the running program like Break
+
+extern volatile bool user_interrupt; // Set when Break or Ctrl-C is pressed
+
 // Function prototypes
 void picocalc_init();
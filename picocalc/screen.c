@@ -18,6 +18,7 @@
 #include <string.h>
 
 #include <pico/stdlib.h>
+#include <pico/multicore.h>
 
 #include "screen.h"
 #include "drivers/font.h"
@@ -41,6 +42,70 @@ static uint16_t gfx_buffer[SCREEN_WIDTH * SCREEN_HEIGHT] = {0};
 static uint16_t txt_buffer[SCREEN_COLUMNS * SCREEN_ROWS] = {0};
 static bool txt_line_font[SCREEN_ROWS] = {false}; // Track if the line has a different font
 
+//  The tiles of the GFX frame buffer changed since it was last sent to the
+//  LCD: bit n of a row is set if the tile in column n has been drawn on.
+//  Changing to a mode that shows graphics marks every tile.
+static uint32_t gfx_dirty[GFX_TILE_ROWS] = {0};
+
+// A drawing command for core 1
+typedef struct
+{
+    uint8_t type;    // One of GFX_CMD_*
+    bool xor;        // XOR the colour rather than set it, or show the turtle for SPRITE
+    uint16_t colour; // Colour to draw in
+    uint8_t rows;    // Rows of tiles the LCD shows, for CLEAR and UPDATE
+    bool all;        // Send every tile for UPDATE, leave the LCD to the next UPDATE for CLEAR,
+                     // start a new polygon for VERTEX, or wrap the shape for POLYGON, ELLIPSE, ARC,
+                     // STROKE and SMOOTH
+    bool filled;     // Fill the shape, for ELLIPSE
+    uint8_t width;   // Width of the pen in pixels for STROKE, or the turtle for SPRITE
+    float x1, y1;    // Point, start of the line, centre of the shape, or the turtle for SPRITE
+    float x2, y2;    // End of the line, radii of the ellipse, radius and heading of the arc,
+                     // or the sine and cosine of the turtle's heading for SPRITE
+    float angle;     // Degrees the arc turns through, for ARC
+} gfx_command_t;
+
+// The turtle, as drawn over the graphics sent to the LCD
+typedef struct
+{
+    float x, y;      // Position
+    float sine;      // Sine of the heading, clockwise from up
+    float cosine;    // Cosine of the heading
+    uint16_t colour; // Colour
+    bool visible;    // Shown at all
+} gfx_sprite_t;
+
+//  Drawing commands waiting for core 1. Core 0 only writes queue_head and
+//  core 1 only writes queue_tail, so neither needs a lock.
+static gfx_command_t gfx_queue[GFX_QUEUE_SIZE];
+static volatile uint32_t queue_head = 0; // Commands pushed by core 0
+static volatile uint32_t queue_tail = 0; // Commands done by core 1
+
+//  The turtles are not drawn in the frame buffer. Core 0 keeps where they
+//  are, and sends the ones that changed to core 1 just before an update,
+//  which draws them over the buffer while the tiles are sent, putting back
+//  the pixels each covered from gfx_under in the reverse order. gfx_shown
+//  is the turtles as they are on the LCD now.
+static gfx_sprite_t gfx_sprite[SPRITE_COUNT] = {0};               // The turtles, on core 0
+static gfx_sprite_t gfx_sent[SPRITE_COUNT] = {0};                 // The turtles as last sent to core 1, on core 0
+static gfx_sprite_t gfx_next[SPRITE_COUNT] = {0};                 // The turtles for the next update, on core 1
+static gfx_sprite_t gfx_shown[SPRITE_COUNT] = {0};                // The turtles on the LCD, on core 1
+static uint16_t gfx_under[SPRITE_COUNT][SPRITE_BOX * SPRITE_BOX]; // Pixels under each turtle, on core 1
+
+static uint32_t gfx_updated = 0;  // Time of the last update, from time_us_32, on core 0
+static bool gfx_deferred = false; // Only update when asked to, on core 0
+static bool gfx_wrap = true;      // Drawing wraps at the edges rather than being clipped, on core 0
+static uint32_t gfx_waiting = 0;  // Microseconds core 0 waited for core 1 since screen_gfx_times
+static uint32_t gfx_drawing = 0;  // Microseconds core 1 was busy since screen_gfx_times
+static uint32_t gfx_frames = 0;   // Updates that sent tiles since screen_gfx_stats, on core 1
+static uint32_t gfx_blits = 0;    // LCD blits since screen_gfx_stats, on core 1
+
+_Static_assert(GFX_TILE_COLUMNS <= 32, "A row of tiles must fit in a 32-bit mask");
+_Static_assert((GFX_QUEUE_SIZE & (GFX_QUEUE_SIZE - 1)) == 0, "GFX_QUEUE_SIZE must be a power of two");
+_Static_assert(SCREEN_WIDTH % GFX_TILE_SIZE == 0 && SCREEN_HEIGHT % GFX_TILE_SIZE == 0 &&
+                   SCREEN_SPLIT_GFX_HEIGHT % GFX_TILE_SIZE == 0,
+               "The screen must be a whole number of tiles");
+
 // The screen can be in one of three modes:
 //
 // 1. Full-screen text mode
@@ -53,45 +118,1547 @@ static bool txt_line_font[SCREEN_ROWS] = {false}; // Track if the line has a dif
 //    This mode uses the top 240 lines for graphics and the bottom 80 lines for text.
 //
 
-static uint8_t screen_mode = SCREEN_MODE_SPLIT;
+static uint8_t screen_mode = SCREEN_MODE_SPLIT;
+
+// Text state
+static const font_t *screen_font = TXT_DEFAULT_FONT; // Default font for text mode
+static uint16_t text_row = 0;                        // The last row written to in text mode
+static uint16_t foreground = TXT_DEFAULT_FOREGROUND; // Default foreground colour (white)
+static uint16_t background = TXT_DEFAULT_BACKGROUND; // Default background colour (black)
+static uint8_t cursor_column = 0;                    // Cursor x position for text mode
+static uint8_t cursor_row = 0;                       // Cursor y position for text mode
+static bool cursor_enabled = true;                   // Cursor visibility state for text mode
+
+//
+//  Helper functions
+//
+
+// Wrap and round a floating point value to the nearest pixel in the range [0, max)
+static int wrap_and_round(float value, int max)
+{
+    // Wrap into [0, max)
+    value = value - floorf(value / max) * max;
+    // Round to nearest integer
+    int pixel = (int)(value + 0.5f);
+    // Wrap again in case rounding pushed out of bounds
+    pixel = ((pixel % max) + max) % max;
+
+    return pixel;
+}
+
+// Mark the tile holding a pixel as needing to be sent to the LCD
+static inline void mark_dirty(int x, int y)
+{
+    gfx_dirty[y >> GFX_TILE_SHIFT] |= 1u << (x >> GFX_TILE_SHIFT);
+}
+
+// Set a pixel in the graphics buffer
+static void set_pixel(int x, int y, uint16_t colour, bool xor)
+{
+    mark_dirty(x, y);
+    if (xor)
+    {
+        gfx_buffer[y * SCREEN_WIDTH + x] ^= colour;
+    }
+    else
+    {
+        gfx_buffer[y * SCREEN_WIDTH + x] = colour;
+    }
+}
+
+//
+//  Line rasterizer
+//
+//  Lines are stepped along their longer axis one pixel at a time, as the
+//  float DDA this replaces did: the increments are worked out in float and
+//  added to each coordinate once per pixel, and each coordinate is wrapped
+//  onto the screen and rounded. To draw exactly the same pixels, every
+//  coordinate is kept in 32.32 fixed point on the grid of the float it
+//  stands for. While a coordinate stays in one binade (between two powers
+//  of two) adding a float increment and rounding is the same as adding the
+//  increment rounded to that binade's grid, so each step is one 64-bit add.
+//  Only when a coordinate moves into another binade, or gets too close to
+//  zero for the fixed-point grid, is a real float add done.
+//
+//  Wrapping and rounding a float to a pixel is a step function of the
+//  coordinate, so rather than working it out for every pixel the stepper
+//  keeps the positions at which the pixel next changes and moves a pointer
+//  into the frame buffer when one is passed. The thresholds sit just below
+//  each half pixel, by half the float spacing there, matching where the
+//  float arithmetic rounds up.
+//
+
+// One axis of a line being drawn
+typedef struct
+{
+    int64_t position; // Coordinate in fixed point, 0 while tiny
+    int64_t step;     // Increment rounded to the grid of the current binade
+    int64_t grid;     // Spacing of floats in the current binade
+    int64_t low;      // Positions strictly between low and high are in the binade
+    int64_t high;     // Upper bound of the binade
+    int64_t next;     // Position at which the coordinate rounds to the next pixel
+    float value;      // Coordinate while too near zero for fixed point
+    float increment;  // Increment added each step
+    bool forward;     // Increment is positive
+    bool tie;         // Increment is exactly halfway between two grid steps
+    bool tiny;        // Coordinate is held in value rather than position
+    int32_t pixel;    // Pixel before wrapping
+    int32_t column;   // Pixel wrapped onto the screen
+    int32_t size;     // Width or height of the screen
+    int32_t stride;   // Distance between pixels along the axis in the frame buffer
+} line_axis_t;
+
+// Position at which a coordinate first rounds to the given pixel, whose
+// column on the screen is column: just below the half pixel, by half the
+// float spacing there
+static inline int64_t line_threshold(int32_t pixel, int32_t column)
+{
+    int64_t below = column == 1 ? (int64_t)1 << 7 : (int64_t)(1u << (31 - __builtin_clz(column - 1))) << 8;
+    return (int64_t)pixel * ((int64_t)1 << LINE_FRACTION_BITS) - ((int64_t)1 << (LINE_FRACTION_BITS - 1)) - below;
+}
+
+// Find the next threshold in the direction the axis moves
+static inline void line_next(line_axis_t *axis)
+{
+    if (axis->forward)
+    {
+        axis->next = line_threshold(axis->pixel + 1, axis->column + 1);
+    }
+    else
+    {
+        axis->next = line_threshold(axis->pixel, axis->column ? axis->column : axis->size);
+    }
+}
+
+// Set up the grid, bounds and rounded step for the binade of the position
+static void line_binade(line_axis_t *axis)
+{
+    int64_t magnitude = axis->position < 0 ? -axis->position : axis->position;
+    int exponent = 63 - __builtin_clzll(magnitude);
+    axis->grid = (int64_t)1 << (exponent - 23);
+    if (axis->position > 0)
+    {
+        axis->low = (int64_t)1 << exponent;
+        axis->high = (int64_t)1 << (exponent + 1);
+    }
+    else
+    {
+        axis->low = -((int64_t)1 << (exponent + 1));
+        axis->high = -((int64_t)1 << exponent);
+    }
+
+    // Round the increment to the grid, exactly and half to even
+    uint32_t bits;
+    memcpy(&bits, &axis->increment, sizeof(bits));
+    int32_t biased = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if (biased)
+    {
+        mantissa |= 1u << 23;
+    }
+    else
+    {
+        biased = 1;
+    }
+    int32_t shift = biased - 95 - exponent; // Increment in grid steps is mantissa * 2^shift
+    uint64_t steps = 0;
+    axis->tie = false;
+    if (shift >= 0)
+    {
+        steps = (uint64_t)mantissa << shift;
+    }
+    else if (shift > -26)
+    {
+        uint32_t rest = mantissa & ((1u << -shift) - 1);
+        uint32_t half = 1u << (-shift - 1);
+        steps = mantissa >> -shift;
+        if (rest > half)
+        {
+            steps++;
+        }
+        axis->tie = rest == half;
+    }
+    if (bits >> 31)
+    {
+        // A tie steps to the lower grid point and lets the parity choose
+        axis->step = -(int64_t)(steps + axis->tie) * axis->grid;
+    }
+    else
+    {
+        axis->step = (int64_t)steps * axis->grid;
+    }
+}
+
+// Hold a float coordinate in fixed point, or as a float if too near zero
+static void line_set(line_axis_t *axis, float value)
+{
+    axis->tiny = fabsf(value) < LINE_FIXED_MIN;
+    if (axis->tiny)
+    {
+        axis->value = value;
+        axis->position = 0; // Rounds to the same pixel as any tiny value
+    }
+    else
+    {
+        axis->position = (int64_t)(value * (float)(1ull << LINE_FRACTION_BITS));
+        line_binade(axis);
+    }
+}
+
+// Start an axis at a coordinate, and find its pixel
+static void line_start(line_axis_t *axis, float value, float increment, int32_t size, int32_t stride)
+{
+    axis->increment = increment;
+    axis->forward = increment > 0.0f;
+    axis->size = size;
+    axis->stride = stride;
+    line_set(axis, value);
+
+    int32_t pixel = (int32_t)((axis->position + ((int64_t)1 << (LINE_FRACTION_BITS - 1))) >> LINE_FRACTION_BITS);
+    int32_t column = (pixel % size + size) % size;
+    while (axis->position >= line_threshold(pixel + 1, column + 1))
+    {
+        pixel++;
+        column = column + 1 == size ? 0 : column + 1;
+    }
+    while (axis->position < line_threshold(pixel, column ? column : size))
+    {
+        pixel--;
+        column = column ? column - 1 : size - 1;
+    }
+    axis->pixel = pixel;
+    axis->column = column;
+    line_next(axis);
+}
+
+// Add the increment to an axis as float arithmetic would, moving the pixel
+// pointer when the coordinate rounds to another pixel
+static inline void line_step(line_axis_t *axis, uint16_t **pixel)
+{
+    int64_t next = axis->position + axis->step;
+    if (axis->tie && (next & axis->grid))
+    {
+        next += axis->grid;
+    }
+    if (!axis->tiny && next > axis->low && next < axis->high)
+    {
+        axis->position = next;
+    }
+    else
+    {
+        // Leaving the binade, or near zero: do the float add
+        float value = axis->tiny ? axis->value : (float)axis->position * (1.0f / (float)(1ull << LINE_FRACTION_BITS));
+        line_set(axis, value + axis->increment);
+    }
+
+    // Float addition is monotonic, so the coordinate only moves one way
+    if (axis->forward)
+    {
+        while (axis->position >= axis->next)
+        {
+            axis->pixel++;
+            *pixel += axis->stride;
+            if (++axis->column == axis->size)
+            {
+                axis->column = 0;
+                *pixel -= axis->size * axis->stride;
+            }
+            line_next(axis);
+        }
+    }
+    else
+    {
+        while (axis->position < axis->next)
+        {
+            axis->pixel--;
+            *pixel -= axis->stride;
+            if (axis->column-- == 0)
+            {
+                axis->column = axis->size - 1;
+                *pixel += axis->size * axis->stride;
+            }
+            line_next(axis);
+        }
+    }
+}
+
+//
+//  Fills
+//
+//  Both fills write whole runs of pixels along a row, two pixels to each
+//  32-bit store, and mark the tiles a run covers in one go.
+//
+//  The flood fill is a scanline fill: it fills the run of pixels around the
+//  seed, then scans the rows above and below each run it fills for more,
+//  keeping the runs still to be scanned on a fixed stack. If the stack is
+//  full the pixels of the run are marked in fill_overflow instead, and once
+//  the stack is empty the fill carries on from each marked run. Only runs
+//  this fill made are marked, so it never spreads from pixels that were in
+//  the fill colour before it started. Every mark is cleared as it is used.
+//
+//  A polygon is filled with an edge table: its edges are sorted by the row
+//  they start on, and each row is filled between pairs of the edges that
+//  cross it, sorted across, so overlapping parts alternate between filled
+//  and not. A pixel is filled if its centre is inside. Corners arrive one
+//  command at a time as the turtle moves, without wrapping, and the filled
+//  rows and runs are wrapped onto the screen, or clipped to it.
+//
+
+// A run of filled pixels waiting for the row next to it to be scanned
+typedef struct
+{
+    int16_t left;  // First pixel of the run
+    int16_t right; // Last pixel of the run
+    int16_t y;     // Row of the run
+    int16_t dy;    // Direction of the row to scan, -1 up or 1 down
+} fill_run_t;
+
+// An edge of a polygon, from the rows it crosses
+typedef struct
+{
+    int32_t top;    // First row the edge crosses
+    int32_t bottom; // Row after the last one it crosses
+    float x;        // Where the edge crosses the current row
+    float x1, y1;   // Top end of the edge
+    float slope;    // Change in x from one row to the next
+} fill_edge_t;
+
+// Two pixels, stored together
+typedef uint32_t __attribute__((may_alias)) pixel_pair_t;
+
+static fill_run_t fill_stack[FILL_STACK];                        // Runs waiting to be scanned, on core 1
+static uint32_t fill_overflow[SCREEN_HEIGHT][SCREEN_WIDTH / 32]; // Runs that did not fit on the stack, on core 1
+static uint32_t fill_rescan[(SCREEN_HEIGHT + 31) / 32];          // Rows with runs in fill_overflow, on core 1
+static fill_edge_t fill_edges[FILL_CORNERS];                     // Edges of the polygon, on core 1
+static fill_edge_t *fill_active[FILL_CORNERS];                   // Edges crossing the current row, on core 1
+static int fill_edge_count = 0;                                  // Edges in fill_edges, on core 1
+static float fill_first_x, fill_first_y;                         // First corner of the polygon, on core 1
+static float fill_last_x, fill_last_y;                           // Last corner of the polygon, on core 1
+
+// Set the pixels from left to right on a row to a colour
+static void fill_row(int y, int left, int right, uint16_t colour)
+{
+    gfx_dirty[y >> GFX_TILE_SHIFT] |= (2u << (right >> GFX_TILE_SHIFT)) - (1u << (left >> GFX_TILE_SHIFT));
+
+    uint16_t *pixel = gfx_buffer + y * SCREEN_WIDTH + left;
+    uint16_t *end = gfx_buffer + y * SCREEN_WIDTH + right + 1;
+    if ((uintptr_t)pixel & 2)
+    {
+        *pixel++ = colour; // Line up on a pair
+    }
+    pixel_pair_t pair = colour | (uint32_t)colour << 16;
+    for (; pixel + 2 <= end; pixel += 2)
+    {
+        *(pixel_pair_t *)pixel = pair;
+    }
+    if (pixel < end)
+    {
+        *pixel = colour;
+    }
+}
+
+// Mark a run of filled pixels whose rows above and below could not go on
+// the stack
+static void fill_mark(int y, int left, int right)
+{
+    uint32_t *bits = fill_overflow[y];
+    for (int x = left; x <= right; x++)
+    {
+        bits[x / 32] |= 1u << (x % 32);
+    }
+    fill_rescan[y / 32] |= 1u << (y % 32);
+}
+
+// Fill the run of pixels of the target colour around a pixel, and queue
+// the rows above and below it to be scanned. Rows the run was already
+// scanned from are only queued where the run reaches past the one it came
+// from.
+static void fill_run(int x, int y, uint16_t target, uint16_t colour, const fill_run_t *from, int *count)
+{
+    const uint16_t *row = gfx_buffer + y * SCREEN_WIDTH;
+    int left = x;
+    int right = x;
+    while (left > 0 && row[left - 1] == target)
+    {
+        left--;
+    }
+    while (right < SCREEN_WIDTH - 1 && row[right + 1] == target)
+    {
+        right++;
+    }
+    fill_row(y, left, right, colour);
+
+    for (int dy = -1; dy <= 1; dy += 2)
+    {
+        if (from && dy == -from->dy && left >= from->left && right <= from->right)
+        {
+            continue; // The row it came from is already filled under it
+        }
+        if (*count == FILL_STACK)
+        {
+            fill_mark(y, left, right);
+            return;
+        }
+        fill_stack[(*count)++] = (fill_run_t){left, right, y, dy};
+    }
+}
+
+// Scan the rows next to the runs on the stack until it is empty
+static void fill_drain(uint16_t target, uint16_t colour, int *count)
+{
+    while (*count)
+    {
+        fill_run_t run = fill_stack[--(*count)];
+        int y = run.y + run.dy;
+        if (y < 0 || y >= SCREEN_HEIGHT)
+        {
+            continue;
+        }
+        const uint16_t *row = gfx_buffer + y * SCREEN_WIDTH;
+        for (int x = run.left; x <= run.right; x++)
+        {
+            if (row[x] == target)
+            {
+                fill_run(x, y, target, colour, &run, count);
+                while (x <= run.right && row[x] != target)
+                {
+                    x++; // Past the run just filled
+                }
+                x--;
+            }
+        }
+    }
+}
+
+// Flood fill the area of one colour around a pixel with another colour
+static void fill_area(float x, float y, uint16_t colour)
+{
+    int seed_x = wrap_and_round(x, SCREEN_WIDTH);
+    int seed_y = wrap_and_round(y, SCREEN_HEIGHT);
+    uint16_t target = gfx_buffer[seed_y * SCREEN_WIDTH + seed_x];
+    if (target == colour)
+    {
+        return;
+    }
+
+    // fill_overflow and fill_rescan are left clear by the last fill
+    int count = 0;
+    fill_run(seed_x, seed_y, target, colour, NULL, &count);
+    fill_drain(target, colour, &count);
+
+    // Carry on from the runs that did not fit on the stack, one at a time
+    // so that the stack is empty for each. Scanning on can mark more.
+    bool marked = true;
+    while (marked)
+    {
+        marked = false;
+        for (int y = 0; y < SCREEN_HEIGHT; y++)
+        {
+            if (!(fill_rescan[y / 32] & (1u << (y % 32))))
+            {
+                continue;
+            }
+            fill_rescan[y / 32] &= ~(1u << (y % 32));
+            marked = true;
+
+            uint32_t *bits = fill_overflow[y];
+            for (int left = 0; left < SCREEN_WIDTH; left++)
+            {
+                if (!(bits[left / 32] & (1u << (left % 32))))
+                {
+                    continue;
+                }
+                int right = left;
+                while (right < SCREEN_WIDTH - 1 && (bits[(right + 1) / 32] & (1u << ((right + 1) % 32))))
+                {
+                    right++;
+                }
+                for (int x = left; x <= right; x++)
+                {
+                    bits[x / 32] &= ~(1u << (x % 32));
+                }
+                fill_stack[count++] = (fill_run_t){left, right, y, -1};
+                fill_stack[count++] = (fill_run_t){left, right, y, 1};
+                fill_drain(target, colour, &count);
+                left = right;
+            }
+        }
+    }
+}
+
+// Fill the pixels whose centres are from x1 to before x2 on a row, wrapping
+// at the edges of the screen or clipped to them
+static void fill_span(int y, float x1, float x2, uint16_t colour, bool wrap)
+{
+    if (!wrap)
+    {
+        if (y < 0 || y >= SCREEN_HEIGHT)
+        {
+            return;
+        }
+        x1 = MAX(x1, 0.0f);
+        x2 = MIN(x2, (float)SCREEN_WIDTH);
+    }
+    int left = (int)ceilf(x1);
+    int right = (int)ceilf(x2) - 1;
+    if (right < left)
+    {
+        return;
+    }
+
+    y = ((y % SCREEN_HEIGHT) + SCREEN_HEIGHT) % SCREEN_HEIGHT;
+    if (right - left >= SCREEN_WIDTH - 1)
+    {
+        fill_row(y, 0, SCREEN_WIDTH - 1, colour);
+        return;
+    }
+    int width = right - left;
+    left = ((left % SCREEN_WIDTH) + SCREEN_WIDTH) % SCREEN_WIDTH;
+    if (left + width < SCREEN_WIDTH)
+    {
+        fill_row(y, left, left + width, colour);
+    }
+    else
+    {
+        fill_row(y, left, SCREEN_WIDTH - 1, colour);
+        fill_row(y, 0, left + width - SCREEN_WIDTH, colour);
+    }
+}
+
+// Add the edge between two corners to the polygon, unless it crosses no
+// row, as a flat edge does
+static void fill_edge(float x1, float y1, float x2, float y2)
+{
+    if (y1 > y2)
+    {
+        float swap = x1;
+        x1 = x2;
+        x2 = swap;
+        swap = y1;
+        y1 = y2;
+        y2 = swap;
+    }
+    float top = ceilf(y1);
+    float bottom = ceilf(y2);
+    if (top >= bottom || fill_edge_count == FILL_CORNERS)
+    {
+        return;
+    }
+
+    float slope = (x2 - x1) / (y2 - y1);
+    fill_edges[fill_edge_count++] = (fill_edge_t){(int32_t)top, (int32_t)bottom, 0.0f, x1, y1, slope};
+}
+
+// Add a corner to the polygon, or start a new one from it. Corners past
+// the last one there is room for are left out, keeping room for the edge
+// that closes the polygon, and ENDFILL gives an error rather than fill it.
+static void fill_corner(float x, float y, bool first)
+{
+    if (first)
+    {
+        fill_edge_count = 0;
+        fill_first_x = x;
+        fill_first_y = y;
+    }
+    else if (fill_edge_count < FILL_CORNERS - 1)
+    {
+        fill_edge(fill_last_x, fill_last_y, x, y);
+    }
+    else
+    {
+        return;
+    }
+    fill_last_x = x;
+    fill_last_y = y;
+}
+
+// Close the polygon and fill it, wrapping it at the edges of the screen or
+// clipping it to them. A wrapped polygon taller than the screen is only
+// filled for the height of the screen from its top.
+static void fill_polygon(uint16_t colour, bool wrap)
+{
+    fill_edge(fill_last_x, fill_last_y, fill_first_x, fill_first_y);
+    int count = fill_edge_count;
+    fill_edge_count = 0;
+    fill_last_x = fill_first_x;
+    fill_last_y = fill_first_y;
+    if (count < 2)
+    {
+        return;
+    }
+
+    // Sort the edges by the row they start on
+    int bottom = fill_edges[0].bottom;
+    for (int i = 1; i < count; i++)
+    {
+        fill_edge_t edge = fill_edges[i];
+        int j = i;
+        for (; j > 0 && fill_edges[j - 1].top > edge.top; j--)
+        {
+            fill_edges[j] = fill_edges[j - 1];
+        }
+        fill_edges[j] = edge;
+        bottom = MAX(bottom, edge.bottom);
+    }
+    int top = fill_edges[0].top;
+    if (wrap)
+    {
+        bottom = MIN(bottom, top + SCREEN_HEIGHT);
+    }
+    else
+    {
+        top = MAX(top, 0);
+        bottom = MIN(bottom, SCREEN_HEIGHT);
+    }
+
+    int next = 0;
+    int active = 0;
+    for (int y = top; y < bottom; y++)
+    {
+        // Add the edges that start on this row, drop those that ended, and
+        // find where the rest cross it. Working it out from the end of the
+        // edge each time keeps long edges from drifting.
+        while (next < count && fill_edges[next].top <= y)
+        {
+            fill_active[active++] = &fill_edges[next++];
+        }
+        int kept = 0;
+        for (int i = 0; i < active; i++)
+        {
+            fill_edge_t *edge = fill_active[i];
+            if (edge->bottom > y)
+            {
+                edge->x = edge->x1 + (y - edge->y1) * edge->slope;
+                fill_active[kept++] = edge;
+            }
+        }
+        active = kept;
+
+        // Sort them across the row; they are mostly in order from the last
+        for (int i = 1; i < active; i++)
+        {
+            fill_edge_t *edge = fill_active[i];
+            int j = i;
+            for (; j > 0 && fill_active[j - 1]->x > edge->x; j--)
+            {
+                fill_active[j] = fill_active[j - 1];
+            }
+            fill_active[j] = edge;
+        }
+
+        for (int i = 0; i + 1 < active; i += 2)
+        {
+            fill_span(y, fill_active[i]->x, fill_active[i + 1]->x, colour, wrap);
+        }
+    }
+}
+
+//
+//  Circles, ellipses and arcs
+//
+//  Ellipses are stepped with the integer midpoint algorithm, one quadrant
+//  of points at a time mirrored into the other three, first along x where
+//  the curve is flatter than 45 degrees and then along y. A circle is an
+//  ellipse with equal radii. Filled shapes fill a run across the rows of
+//  each pair of mirrored points. An arc draws the points of its circle
+//  that are clockwise from its start by no more than the angle it turns
+//  through, tested with cross products rather than an angle per pixel.
+//
+
+// The ends of an arc, as directions from its centre
+typedef struct
+{
+    float start_x, start_y; // Direction of the start
+    float end_x, end_y;     // Direction of the end
+    bool wide;              // Turns through more than 180 degrees
+} gfx_arc_t;
+
+// An ellipse or arc being drawn
+typedef struct
+{
+    int x, y;             // Centre pixel
+    int rx, ry;           // Radii in pixels
+    uint16_t colour;      // Colour to draw in
+    bool filled;          // Fill it rather than draw its edge
+    bool wrap;            // Wrap it at the edges of the screen rather than clip it
+    const gfx_arc_t *arc; // Part of the circle to draw, or NULL for all of it
+} gfx_shape_t;
+
+// Round a radius to whole pixels, no more than SHAPE_RADIUS_MAX
+static int shape_radius(float radius)
+{
+    return (int)(MIN(fabsf(radius), (float)SHAPE_RADIUS_MAX) + 0.5f);
+}
+
+// Set a pixel of a shape, wrapping it onto the screen or leaving it out
+// if it is off the screen
+static void shape_point(int x, int y, uint16_t colour, bool wrap)
+{
+    if (wrap)
+    {
+        x = ((x % SCREEN_WIDTH) + SCREEN_WIDTH) % SCREEN_WIDTH;
+        y = ((y % SCREEN_HEIGHT) + SCREEN_HEIGHT) % SCREEN_HEIGHT;
+    }
+    else if (x < 0 || x >= SCREEN_WIDTH || y < 0 || y >= SCREEN_HEIGHT)
+    {
+        return;
+    }
+    set_pixel(x, y, colour, false);
+}
+
+// Fill the pixels from left to right on a row of a shape
+static void shape_span(int y, int left, int right, uint16_t colour, bool wrap)
+{
+    fill_span(y, (float)left, (float)right + 1.0f, colour, wrap);
+}
+
+// Check if a point, from the centre of an arc, is on the arc
+static bool arc_contains(const gfx_arc_t *arc, int dx, int dy)
+{
+    float start = arc->start_x * dy - arc->start_y * dx; // Clockwise from the start
+    float end = dx * arc->end_y - dy * arc->end_x;       // Anticlockwise from the end
+    if (arc->wide)
+    {
+        return start >= 0.0f || end >= 0.0f;
+    }
+    return start >= 0.0f && end >= 0.0f;
+}
+
+// Draw or fill the four points mirrored about the centre of an ellipse
+static void shape_quadrant(const gfx_shape_t *shape, int x, int y)
+{
+    int cx = shape->x;
+    int cy = shape->y;
+    if (shape->filled)
+    {
+        shape_span(cy - y, cx - x, cx + x, shape->colour, shape->wrap);
+        if (y)
+        {
+            shape_span(cy + y, cx - x, cx + x, shape->colour, shape->wrap);
+        }
+        return;
+    }
+
+    int points[4][2] = {{x, y}, {-x, y}, {x, -y}, {-x, -y}};
+    for (int i = 0; i < 4; i++)
+    {
+        int dx = points[i][0];
+        int dy = points[i][1];
+        if (!shape->arc || arc_contains(shape->arc, dx, dy))
+        {
+            shape_point(cx + dx, cy + dy, shape->colour, shape->wrap);
+        }
+    }
+}
+
+// Draw an ellipse, or an arc of a circle, with the midpoint algorithm
+static void draw_shape(const gfx_shape_t *shape)
+{
+    int64_t rx2 = (int64_t)shape->rx * shape->rx;
+    int64_t ry2 = (int64_t)shape->ry * shape->ry;
+    int x = 0;
+    int y = shape->ry;
+    int64_t px = 0;           // 2 * ry2 * x
+    int64_t py = 2 * rx2 * y; // 2 * rx2 * y
+
+    if (shape->ry == 0)
+    {
+        for (; x <= shape->rx; x++)
+        {
+            shape_quadrant(shape, x, 0); // Flat, a line across
+        }
+        return;
+    }
+
+    // Along x, while the slope is under 1. The decision variables are four
+    // times the usual ones, to keep them whole. A filled shape only needs
+    // the widest point on each row, the last before y steps.
+    int64_t p = 4 * ry2 - 4 * rx2 * shape->ry + rx2;
+    while (px < py)
+    {
+        if (!shape->filled || p >= 0)
+        {
+            shape_quadrant(shape, x, y);
+        }
+        x++;
+        px += 2 * ry2;
+        if (p < 0)
+        {
+            p += 4 * (ry2 + px);
+        }
+        else
+        {
+            y--;
+            py -= 2 * rx2;
+            p += 4 * (ry2 + px - py);
+        }
+    }
+
+    // Along y for the rest
+    p = ry2 * (4 * (int64_t)x * x + 4 * x + 1) + 4 * rx2 * ((int64_t)(y - 1) * (y - 1) - ry2);
+    while (y >= 0)
+    {
+        shape_quadrant(shape, x, y);
+        y--;
+        py -= 2 * rx2;
+        if (p > 0)
+        {
+            p += 4 * (rx2 - py);
+        }
+        else
+        {
+            x++;
+            px += 2 * ry2;
+            p += 4 * (rx2 - py + px);
+        }
+    }
+}
+
+// Draw an ellipse, or fill it, centred on a point
+static void draw_ellipse(float x, float y, float rx, float ry, uint16_t colour, bool filled, bool wrap)
+{
+    gfx_shape_t shape = {(int)floorf(x + 0.5f), (int)floorf(y + 0.5f), shape_radius(rx), shape_radius(ry),
+                         colour, filled, wrap, NULL};
+    draw_shape(&shape);
+}
+
+// Draw an arc of a circle centred on a point, from a heading clockwise
+// through an angle, both in degrees
+static void draw_arc(float x, float y, float radius, float heading, float angle, uint16_t colour, bool wrap)
+{
+    if (angle < 0.0f)
+    {
+        heading += angle; // Go clockwise from the other end
+        angle = -angle;
+    }
+    float start = heading * (M_PI / 180.0f);
+    float end = (heading + angle) * (M_PI / 180.0f);
+    gfx_arc_t arc = {sinf(start), -cosf(start), sinf(end), -cosf(end), angle > 180.0f};
+
+    int r = shape_radius(radius);
+    gfx_shape_t shape = {(int)floorf(x + 0.5f), (int)floorf(y + 0.5f), r, r, colour, false, wrap,
+                         angle < 360.0f ? &arc : NULL};
+    draw_shape(&shape);
+}
+
+//
+//  Wide pens
+//
+//  A line drawn with a pen wider than a pixel is filled as a rectangle as
+//  long as the line and as wide as the pen, with a disc the width of the
+//  pen at each end to round the joins between lines. Both are filled a
+//  row at a time with the span fill, rather than as parallel lines, so a
+//  wide line costs about one span per row it crosses. A line that starts
+//  where the last one ended skips its first disc, as that one is drawn.
+//
+
+static float stroke_end_x = NAN, stroke_end_y = NAN; // Where the last wide line ended, on core 1
+static int stroke_end_width = 0;                     // Width of the pen that drew it, on core 1
+
+// Fill the pixels within a radius of a point
+static void fill_disc(float x, float y, float radius, uint16_t colour, bool wrap)
+{
+    int top = (int)ceilf(y - radius);
+    int bottom = (int)ceilf(y + radius);
+    for (int row = top; row < bottom; row++)
+    {
+        float dy = row - y;
+        float half = sqrtf(MAX(radius * radius - dy * dy, 0.0f));
+        fill_span(row, x - half, x + half, colour, wrap);
+    }
+}
+
+// Draw a line with a pen of a width in pixels
+static void draw_stroke(float x1, float y1, float x2, float y2, int width, uint16_t colour, bool wrap)
+{
+    float radius = width / 2.0f;
+    if (x1 != stroke_end_x || y1 != stroke_end_y || width != stroke_end_width)
+    {
+        fill_disc(x1, y1, radius, colour, wrap);
+    }
+    fill_disc(x2, y2, radius, colour, wrap);
+    stroke_end_x = x2;
+    stroke_end_y = y2;
+    stroke_end_width = width;
+
+    float dx = x2 - x1;
+    float dy = y2 - y1;
+    float length = sqrtf(dx * dx + dy * dy);
+    if (length == 0.0f)
+    {
+        return;
+    }
+
+    // The corners of the rectangle, half the width to each side of the line
+    float nx = -dy * radius / length;
+    float ny = dx * radius / length;
+    float corners[4][2] = {{x1 + nx, y1 + ny}, {x2 + nx, y2 + ny}, {x2 - nx, y2 - ny}, {x1 - nx, y1 - ny}};
+    float top = MIN(MIN(corners[0][1], corners[1][1]), MIN(corners[2][1], corners[3][1]));
+    float bottom = MAX(MAX(corners[0][1], corners[1][1]), MAX(corners[2][1], corners[3][1]));
+
+    // The rectangle is convex, so each row is filled from the leftmost to
+    // the rightmost of the edges crossing it
+    for (int row = (int)ceilf(top); row < (int)ceilf(bottom); row++)
+    {
+        float left = INFINITY;
+        float right = -INFINITY;
+        for (int i = 0; i < 4; i++)
+        {
+            const float *a = corners[i];
+            const float *b = corners[(i + 1) % 4];
+            if ((a[1] <= row && row < b[1]) || (b[1] <= row && row < a[1]))
+            {
+                float x = a[0] + (row - a[1]) * (b[0] - a[0]) / (b[1] - a[1]);
+                left = MIN(left, x);
+                right = MAX(right, x);
+            }
+        }
+        if (left < right)
+        {
+            fill_span(row, left, right, colour, wrap);
+        }
+    }
+}
+
+//
+//  Smooth lines
+//
+//  A smooth line is drawn with Xiaolin Wu's algorithm: stepping along its
+//  longer axis, each step blends the colour into the two pixels either
+//  side of the line, each by how close the line passes to its centre. The
+//  position across the line is kept in 16.16 fixed point, so a step is one
+//  add, and the coverage is the top bits of its fraction.
+//
+//  Blending spreads an RGB565 pixel across a 32-bit word, as green in the
+//  top half and red and blue in the bottom, with room above each channel
+//  for it times the coverage. All three channels are then mixed with one
+//  subtract, one multiply and one add, rather than unpacked one by one.
+//  Where the two pixels of a step are side by side in one pair they are
+//  read and written together.
+//
+
+// Blend a colour into a pixel, by a coverage from 0 to SMOOTH_OPAQUE
+static inline uint16_t smooth_blend(uint16_t under, uint16_t colour, uint32_t coverage)
+{
+    uint32_t from = (under | (uint32_t)under << 16) & SMOOTH_CHANNELS;
+    uint32_t to = (colour | (uint32_t)colour << 16) & SMOOTH_CHANNELS;
+    uint32_t mixed = (from + (((to - from) * coverage) >> SMOOTH_COVERAGE_BITS)) & SMOOTH_CHANNELS;
+    return (uint16_t)(mixed | mixed >> 16);
+}
+
+// Blend a colour into a pixel of a smooth line, wrapping it onto the
+// screen or leaving it out if it is off the screen
+static void smooth_point(int x, int y, uint16_t colour, uint32_t coverage, bool wrap)
+{
+    if (coverage == 0)
+    {
+        return;
+    }
+    if ((unsigned)x >= SCREEN_WIDTH || (unsigned)y >= SCREEN_HEIGHT)
+    {
+        if (!wrap)
+        {
+            return;
+        }
+        x = ((x % SCREEN_WIDTH) + SCREEN_WIDTH) % SCREEN_WIDTH;
+        y = ((y % SCREEN_HEIGHT) + SCREEN_HEIGHT) % SCREEN_HEIGHT;
+    }
+    mark_dirty(x, y);
+    uint16_t *pixel = gfx_buffer + y * SCREEN_WIDTH + x;
+    *pixel = smooth_blend(*pixel, colour, coverage);
+}
+
+// Blend a colour into two pixels side by side, the left one by a coverage
+// and the right one by the rest
+static void smooth_pair(int x, int y, uint16_t colour, uint32_t coverage, bool wrap)
+{
+    if ((x & 1) || (unsigned)x >= SCREEN_WIDTH || (unsigned)y >= SCREEN_HEIGHT)
+    {
+        smooth_point(x, y, colour, coverage, wrap);
+        smooth_point(x + 1, y, colour, SMOOTH_OPAQUE - coverage, wrap);
+        return;
+    }
+    mark_dirty(x, y);
+    pixel_pair_t *pixels = (pixel_pair_t *)(gfx_buffer + y * SCREEN_WIDTH + x);
+    pixel_pair_t pair = *pixels;
+    uint32_t left = smooth_blend((uint16_t)pair, colour, coverage);
+    uint32_t right = smooth_blend((uint16_t)(pair >> 16), colour, SMOOTH_OPAQUE - coverage);
+    *pixels = left | right << 16;
+}
+
+// Draw an anti-aliased line
+static void draw_smooth(float x1, float y1, float x2, float y2, uint16_t colour, bool wrap)
+{
+    // Step along x, swapping the axes of a steep line
+    bool steep = fabsf(y2 - y1) > fabsf(x2 - x1);
+    if (steep)
+    {
+        float swap = x1;
+        x1 = y1;
+        y1 = swap;
+        swap = x2;
+        x2 = y2;
+        y2 = swap;
+    }
+    if (x1 > x2)
+    {
+        float swap = x1;
+        x1 = x2;
+        x2 = swap;
+        swap = y1;
+        y1 = y2;
+        y2 = swap;
+    }
+    if (wrap)
+    {
+        // Move the line by whole screens to start on the screen, so its
+        // pixels only need wrapping once it leaves
+        float along = steep ? SCREEN_HEIGHT : SCREEN_WIDTH;
+        float across = steep ? SCREEN_WIDTH : SCREEN_HEIGHT;
+        float shift = floorf(x1 / along) * along;
+        x1 -= shift;
+        x2 -= shift;
+        shift = floorf(y1 / across) * across;
+        y1 -= shift;
+        y2 -= shift;
+    }
+
+    float gradient = x2 > x1 ? (y2 - y1) / (x2 - x1) : 0.0f;
+    int first = (int)floorf(x1 + 0.5f);
+    int last = (int)floorf(x2 + 0.5f);
+    int64_t y = (int64_t)((y1 + gradient * (first - x1)) * SMOOTH_ONE);
+    int32_t step = (int32_t)(gradient * SMOOTH_ONE);
+    for (int x = first; x <= last; x++, y += step)
+    {
+        // The line passes between the pixel below it and the next one, and
+        // covers each by how close it is
+        int near = (int)(y >> SMOOTH_FRACTION_BITS);
+        uint32_t coverage = (uint32_t)(y >> (SMOOTH_FRACTION_BITS - SMOOTH_COVERAGE_BITS)) & (SMOOTH_OPAQUE - 1);
+        if (steep)
+        {
+            smooth_pair(near, x, colour, SMOOTH_OPAQUE - coverage, wrap);
+        }
+        else
+        {
+            smooth_point(x, near, colour, SMOOTH_OPAQUE - coverage, wrap);
+            smooth_point(x, near + 1, colour, coverage, wrap);
+        }
+    }
+}
+
+//
+//  Drawing on core 1
+//
+//  Core 1 owns the graphics buffer and sends it to the LCD, so drawing and
+//  sending overlap with the interpreter on core 0. The screen_gfx_
+//  functions push commands onto a single-producer, single-consumer ring,
+//  which core 1 runs in order. Core 0 only waits when the ring is full, or
+//  at a fence: before it reads pixels back or uses the LCD itself, which
+//  it does for text.
+//
+
+// Send the dirty tiles in the top rows of tiles to the LCD and mark every
+// tile clean. Runs of dirty tiles across a row of tiles are sent together,
+// a line of pixels at a time as the lines of a run are not next to each
+// other in the buffer, or all at once if the run is the full width of the
+// screen.
+static void send_tiles(int rows)
+{
+    uint32_t blits = gfx_blits;
+    for (int row = 0; row < rows; row++)
+    {
+        uint32_t dirty = gfx_dirty[row];
+        int top = row * GFX_TILE_SIZE;
+        while (dirty)
+        {
+            int first = __builtin_ctz(dirty);
+            int last = first;
+            while (last + 1 < GFX_TILE_COLUMNS && (dirty & (1u << (last + 1))))
+            {
+                last++;
+            }
+            dirty &= ~((2u << last) - (1u << first));
+
+            int left = first * GFX_TILE_SIZE;
+            int width = (last + 1 - first) * GFX_TILE_SIZE;
+            if (width == SCREEN_WIDTH)
+            {
+                lcd_blit(gfx_buffer + top * SCREEN_WIDTH, 0, top, SCREEN_WIDTH, GFX_TILE_SIZE);
+                gfx_blits++;
+            }
+            else
+            {
+                for (int y = top; y < top + GFX_TILE_SIZE; y++)
+                {
+                    lcd_blit(gfx_buffer + y * SCREEN_WIDTH + left, left, y, width, 1);
+                }
+                gfx_blits += GFX_TILE_SIZE;
+            }
+        }
+    }
+    memset(gfx_dirty, 0, sizeof(gfx_dirty));
+    if (gfx_blits != blits)
+    {
+        gfx_frames++;
+    }
+}
+
+// Clear the graphics buffer, and the LCD if it shows the top rows of tiles
+static void clear_frame(int rows, bool deferred)
+{
+    memset(gfx_buffer, 0, sizeof(gfx_buffer)); // Clear the graphics buffer
+    stroke_end_width = 0;                      // Along with the end of the last wide line
+
+    if (deferred)
+    {
+        // Keep the old picture on the LCD until the next update replaces it
+        for (int row = 0; row < GFX_TILE_ROWS; row++)
+        {
+            gfx_dirty[row] = GFX_TILES_ALL;
+        }
+        return;
+    }
+
+    memset(gfx_dirty, 0, sizeof(gfx_dirty)); // The LCD is cleared to match
+    for (int i = 0; i < SPRITE_COUNT; i++)
+    {
+        gfx_shown[i].visible = false; // Along with the turtles on it
+    }
+
+    if (rows == GFX_TILE_ROWS)
+    {
+        lcd_clear_screen(); // Clear the LCD screen in graphics mode
+    }
+    else if (rows)
+    {
+        // Clear the graphics area in split mode
+        lcd_solid_rectangle(background, 0, 0, SCREEN_WIDTH, rows * GFX_TILE_SIZE);
+    }
+}
+
+// Draw a point in the graphics buffer
+static void draw_point(float x, float y, uint16_t colour, bool xor)
+{
+    int pixel_x = wrap_and_round(x, SCREEN_WIDTH);
+    int pixel_y = wrap_and_round(y, SCREEN_HEIGHT);
+
+    set_pixel(pixel_x, pixel_y, colour, xor);
+}
+
+// Draw a line in the graphics buffer, wrapping at the edges
+static void draw_line(float x1, float y1, float x2, float y2, uint16_t colour, bool xor)
+{
+    // Calculate the number of steps based on the longest axis
+    float dx = x2 - x1;
+    float dy = y2 - y1;
+    int steps = (int)ceilf(fmaxf(fabsf(dx), fabsf(dy)));
+
+    if (steps == 0)
+    {
+        // Single point
+        draw_point(x1, y1, colour, xor);
+        return;
+    }
 
-// Text state
-static const font_t *screen_font = TXT_DEFAULT_FONT; // Default font for text mode
-static uint16_t text_row = 0;                        // The last row written to in text mode
-static uint16_t foreground = TXT_DEFAULT_FOREGROUND; // Default foreground colour (white)
-static uint16_t background = TXT_DEFAULT_BACKGROUND; // Default background colour (black)
-static uint8_t cursor_column = 0;                    // Cursor x position for text mode
-static uint8_t cursor_row = 0;                       // Cursor y position for text mode
-static bool cursor_enabled = true;                   // Cursor visibility state for text mode
+    float x_inc = dx / steps;
+    float y_inc = dy / steps;
 
-//
-//  Helper functions
-//
+    if (!(fabsf(x1) < LINE_COORD_MAX && fabsf(y1) < LINE_COORD_MAX &&
+          fabsf(x2) < LINE_COORD_MAX && fabsf(y2) < LINE_COORD_MAX))
+    {
+        // Too far off the screen for fixed point, step in float
+        float x = x1;
+        float y = y1;
+        for (int i = 0; i <= steps; ++i)
+        {
+            draw_point(x, y, colour, xor);
+            x += x_inc;
+            y += y_inc;
+        }
+        return;
+    }
 
-// Wrap and round a floating point value to the nearest pixel in the range [0, max)
-static int wrap_and_round(float value, int max)
+    line_axis_t x, y;
+    line_start(&x, x1, x_inc, SCREEN_WIDTH, 1);
+    line_start(&y, y1, y_inc, SCREEN_HEIGHT, SCREEN_WIDTH);
+    uint16_t *pixel = gfx_buffer + y.column * SCREEN_WIDTH + x.column;
+
+    for (int i = 0;; ++i)
+    {
+        mark_dirty(x.column, y.column);
+        if (xor)
+        {
+            *pixel ^= colour;
+        }
+        else
+        {
+            *pixel = colour;
+        }
+        if (i == steps)
+        {
+            break;
+        }
+        line_step(&x, &pixel);
+        line_step(&y, &pixel);
+    }
+}
+
+// Find the top left corner of the box the turtle is drawn in
+static void sprite_box(const gfx_sprite_t *sprite, int *left, int *top)
 {
-    // Wrap into [0, max)
-    value = value - floorf(value / max) * max;
-    // Round to nearest integer
-    int pixel = (int)(value + 0.5f);
-    // Wrap again in case rounding pushed out of bounds
-    pixel = ((pixel % max) + max) % max;
+    *left = wrap_and_round(sprite->x, SCREEN_WIDTH) - SPRITE_RADIUS + SCREEN_WIDTH;
+    *top = wrap_and_round(sprite->y, SCREEN_HEIGHT) - SPRITE_RADIUS + SCREEN_HEIGHT;
+}
 
-    return pixel;
+// Mark the tiles the turtle covers as needing to be sent, or check if any
+// of them already are
+static bool sprite_tiles(const gfx_sprite_t *sprite, bool mark)
+{
+    int left, top;
+    sprite_box(sprite, &left, &top);
+    // Pixels a tile apart, and the far edges, land in every tile the box does
+    for (int j = 0; j < SPRITE_BOX + GFX_TILE_SIZE - 1; j += GFX_TILE_SIZE)
+    {
+        for (int i = 0; i < SPRITE_BOX + GFX_TILE_SIZE - 1; i += GFX_TILE_SIZE)
+        {
+            int x = (left + (i < SPRITE_BOX ? i : SPRITE_BOX - 1)) % SCREEN_WIDTH;
+            int y = (top + (j < SPRITE_BOX ? j : SPRITE_BOX - 1)) % SCREEN_HEIGHT;
+            if (mark)
+            {
+                mark_dirty(x, y);
+            }
+            else if (gfx_dirty[y >> GFX_TILE_SHIFT] & (1u << (x >> GFX_TILE_SHIFT)))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
 }
 
-// Set a pixel in the graphics buffer
-static void set_pixel(int x, int y, uint16_t colour, bool xor)
+// Copy the pixels under a turtle to or from its part of gfx_under
+static void sprite_save(const gfx_sprite_t *sprite, uint16_t *under, bool restore)
 {
-    if (xor)
+    int left, top;
+    sprite_box(sprite, &left, &top);
+    for (int j = 0; j < SPRITE_BOX; j++)
     {
-        gfx_buffer[y * SCREEN_WIDTH + x] ^= colour;
+        uint16_t *line = &gfx_buffer[(top + j) % SCREEN_HEIGHT * SCREEN_WIDTH];
+        for (int i = 0; i < SPRITE_BOX; i++)
+        {
+            uint16_t *pixel = &line[(left + i) % SCREEN_WIDTH];
+            if (restore)
+            {
+                *pixel = *under++;
+            }
+            else
+            {
+                *under++ = *pixel;
+            }
+        }
     }
-    else
+}
+
+// Draw the turtle triangle in the frame buffer
+static void sprite_draw(const gfx_sprite_t *sprite)
+{
+    float s = sprite->sine;
+    float c = sprite->cosine;
+
+    float x1 = sprite->x + SPRITE_HALF_BASE * c;
+    float y1 = sprite->y + SPRITE_HALF_BASE * s;
+    float x2 = sprite->x - SPRITE_HALF_BASE * c;
+    float y2 = sprite->y - SPRITE_HALF_BASE * s;
+    float x3 = sprite->x + SPRITE_HEIGHT * s;
+    float y3 = sprite->y - SPRITE_HEIGHT * c;
+
+    draw_line(x1, y1, x2, y2, sprite->colour, false);
+    draw_line(x2, y2, x3, y3, sprite->colour, false);
+    draw_line(x3, y3, x1, y1, sprite->colour, false);
+}
+
+// Check if two turtles look the same
+static bool sprite_equal(const gfx_sprite_t *a, const gfx_sprite_t *b)
+{
+    return a->visible == b->visible && a->x == b->x && a->y == b->y && a->sine == b->sine &&
+           a->cosine == b->cosine && a->colour == b->colour;
+}
+
+// Send the dirty tiles in the top rows of tiles to the LCD with the turtles
+// drawn over them. A turtle is only drawn if a tile it covers is sent: when
+// it has moved, or something was drawn under it. All of them are drawn
+// before any tile is sent, and taken off again in the reverse order, so
+// turtles on top of each other put back the right pixels.
+static void present(int rows)
+{
+    bool drawn[SPRITE_COUNT];
+    for (int i = 0; i < SPRITE_COUNT; i++)
     {
-        gfx_buffer[y * SCREEN_WIDTH + x] = colour;
+        if (!sprite_equal(&gfx_next[i], &gfx_shown[i]))
+        {
+            if (gfx_shown[i].visible)
+            {
+                sprite_tiles(&gfx_shown[i], true); // Send the pixels it covered on the LCD
+            }
+            if (gfx_next[i].visible)
+            {
+                sprite_tiles(&gfx_next[i], true);
+            }
+        }
+    }
+
+    for (int i = 0; i < SPRITE_COUNT; i++)
+    {
+        drawn[i] = gfx_next[i].visible && sprite_tiles(&gfx_next[i], false);
+        if (drawn[i])
+        {
+            sprite_save(&gfx_next[i], gfx_under[i], false);
+            sprite_draw(&gfx_next[i]);
+        }
+    }
+    send_tiles(rows);
+    for (int i = SPRITE_COUNT - 1; i >= 0; i--)
+    {
+        if (drawn[i])
+        {
+            sprite_save(&gfx_next[i], gfx_under[i], true);
+        }
+    }
+    memcpy(gfx_shown, gfx_next, sizeof(gfx_shown));
+}
+
+// Run one drawing command
+static void run_command(const gfx_command_t *command)
+{
+    switch (command->type)
+    {
+    case GFX_CMD_LINE:
+        draw_line(command->x1, command->y1, command->x2, command->y2, command->colour, command->xor);
+        break;
+
+    case GFX_CMD_STROKE:
+        draw_stroke(command->x1, command->y1, command->x2, command->y2, command->width, command->colour,
+                    command->all);
+        break;
+
+    case GFX_CMD_SMOOTH:
+        draw_smooth(command->x1, command->y1, command->x2, command->y2, command->colour, command->all);
+        break;
+
+    case GFX_CMD_POINT:
+        draw_point(command->x1, command->y1, command->colour, command->xor);
+        break;
+
+    case GFX_CMD_CLEAR:
+        clear_frame(command->rows, command->all);
+        break;
+
+    case GFX_CMD_FILL:
+        fill_area(command->x1, command->y1, command->colour);
+        break;
+
+    case GFX_CMD_VERTEX:
+        fill_corner(command->x1, command->y1, command->all);
+        break;
+
+    case GFX_CMD_POLYGON:
+        fill_polygon(command->colour, command->all);
+        break;
+
+    case GFX_CMD_ELLIPSE:
+        draw_ellipse(command->x1, command->y1, command->x2, command->y2, command->colour, command->filled,
+                     command->all);
+        break;
+
+    case GFX_CMD_ARC:
+        draw_arc(command->x1, command->y1, command->x2, command->y2, command->angle, command->colour,
+                 command->all);
+        break;
+
+    case GFX_CMD_UPDATE:
+        if (command->all)
+        {
+            for (int row = 0; row < GFX_TILE_ROWS; row++)
+            {
+                gfx_dirty[row] = GFX_TILES_ALL;
+            }
+        }
+        present(command->rows);
+        break;
+
+    case GFX_CMD_SPRITE:
+        gfx_next[command->width] =
+            (gfx_sprite_t){command->x1, command->y1, command->x2, command->y2, command->colour, command->xor};
+        break;
+    }
+}
+
+// Core 1: run drawing commands as they are pushed, timing how long it is busy
+static void gfx_core1(void)
+{
+    uint32_t busy_since = 0;
+    bool busy = false;
+    while (true)
+    {
+        uint32_t tail = queue_tail;
+        if (tail == queue_head)
+        {
+            if (busy)
+            {
+                gfx_drawing += time_us_32() - busy_since;
+                busy = false;
+            }
+            __wfe();
+            continue;
+        }
+        if (!busy)
+        {
+            busy_since = time_us_32();
+            busy = true;
+        }
+
+        __mem_fence_acquire();
+        run_command(&gfx_queue[tail % GFX_QUEUE_SIZE]);
+        if (tail + 1 == queue_head)
+        {
+            // Done for now: count the time before core 0 can see the ring is empty
+            gfx_drawing += time_us_32() - busy_since;
+            busy = false;
+        }
+        __mem_fence_release();
+        queue_tail = tail + 1;
+    }
+}
+
+// Push a drawing command for core 1, waiting if the ring is full
+static void push(gfx_command_t command)
+{
+    uint32_t head = queue_head;
+    if (head - queue_tail == GFX_QUEUE_SIZE)
+    {
+        uint32_t start = time_us_32();
+        while (head - queue_tail == GFX_QUEUE_SIZE)
+        {
+            tight_loop_contents();
+        }
+        gfx_waiting += time_us_32() - start;
+    }
+    gfx_queue[head % GFX_QUEUE_SIZE] = command;
+    __mem_fence_release();
+    queue_head = head + 1;
+    __sev();
+}
+
+// Rows of tiles the LCD shows in the current mode
+static int visible_rows(void)
+{
+    if (screen_mode == SCREEN_MODE_GFX)
+    {
+        return GFX_TILE_ROWS;
+    }
+    if (screen_mode == SCREEN_MODE_SPLIT)
+    {
+        return SCREEN_SPLIT_GFX_HEIGHT / GFX_TILE_SIZE; // The graphics area only
+    }
+    return 0;
+}
+
+// Clip a line to the screen, inset by LINE_CLIP_INSET so that no point on
+// it rounds to a pixel off the screen, with Liang-Barsky. A wide line is
+// clipped to the screen grown by a margin, leaving the edges of its stroke
+// to be clipped as it is filled. Returns false if none of it is on the
+// screen.
+static bool clip_line(float *x1, float *y1, float *x2, float *y2, float margin)
+{
+    const float low = -0.5f + LINE_CLIP_INSET - margin;
+    const float right = SCREEN_WIDTH - 0.5f - LINE_CLIP_INSET + margin;
+    const float bottom = SCREEN_HEIGHT - 0.5f - LINE_CLIP_INSET + margin;
+
+    // Most lines are all on the screen or all off one side of it
+    bool in1 = *x1 >= low && *x1 <= right && *y1 >= low && *y1 <= bottom;
+    bool in2 = *x2 >= low && *x2 <= right && *y2 >= low && *y2 <= bottom;
+    if (in1 && in2)
+    {
+        return true;
+    }
+    if ((*x1 < low && *x2 < low) || (*x1 > right && *x2 > right) ||
+        (*y1 < low && *y2 < low) || (*y1 > bottom && *y2 > bottom))
+    {
+        return false;
+    }
+
+    // Narrow the part of the line, from 0 to 1 along it, inside each edge
+    float dx = *x2 - *x1;
+    float dy = *y2 - *y1;
+    float p[4] = {-dx, dx, -dy, dy};
+    float q[4] = {*x1 - low, right - *x1, *y1 - low, bottom - *y1};
+    float t1 = 0.0f;
+    float t2 = 1.0f;
+    for (int i = 0; i < 4; i++)
+    {
+        if (p[i] == 0.0f)
+        {
+            if (q[i] < 0.0f)
+            {
+                return false; // Parallel to the edge and outside it
+            }
+            continue;
+        }
+        float t = q[i] / p[i];
+        if (p[i] < 0.0f)
+        {
+            if (t > t2)
+            {
+                return false;
+            }
+            t1 = MAX(t1, t);
+        }
+        else
+        {
+            if (t < t1)
+            {
+                return false;
+            }
+            t2 = MIN(t2, t);
+        }
+    }
+
+    float x = *x1;
+    float y = *y1;
+    if (t1 > 0.0f)
+    {
+        *x1 = x + t1 * dx;
+        *y1 = y + t1 * dy;
     }
+    if (t2 < 1.0f)
+    {
+        *x2 = x + t2 * dx;
+        *y2 = y + t2 * dy;
+    }
+    return true;
+}
+
+// Push an update, after the turtles that changed since the last one,
+// sending every tile if all
+static void push_update(bool all)
+{
+    for (int i = 0; i < SPRITE_COUNT; i++)
+    {
+        const gfx_sprite_t *sprite = &gfx_sprite[i];
+        if (!sprite_equal(sprite, &gfx_sent[i]))
+        {
+            push((gfx_command_t){.type = GFX_CMD_SPRITE,
+                                 .width = (uint8_t)i,
+                                 .xor = sprite->visible,
+                                 .colour = sprite->colour,
+                                 .x1 = sprite->x,
+                                 .y1 = sprite->y,
+                                 .x2 = sprite->sine,
+                                 .y2 = sprite->cosine});
+            gfx_sent[i] = *sprite;
+        }
+    }
+    push((gfx_command_t){.type = GFX_CMD_UPDATE, .rows = visible_rows(), .all = all});
 }
 
 // Helper function to scroll the text buffer up one line
@@ -170,6 +1737,7 @@ void screen_set_mode(uint8_t mode)
 {
     if (mode == SCREEN_MODE_TXT || mode == SCREEN_MODE_GFX || mode == SCREEN_MODE_SPLIT)
     {
+        screen_gfx_fence();
         screen_mode = mode;
 
         if (mode == SCREEN_MODE_TXT)
@@ -183,12 +1751,12 @@ void screen_set_mode(uint8_t mode)
         {
             // In full-screen graphics mode, we clear the screen
             lcd_define_scrolling(0, 0); // No scrolling area in full-screen graphics mode
-            screen_gfx_update();
+            push_update(true);
         }
         else if (mode == SCREEN_MODE_SPLIT)
         {
             lcd_define_scrolling(SCREEN_SPLIT_GFX_HEIGHT, 0); // Set scrolling area for text at the bottom
-            screen_gfx_update();
+            push_update(true);
             screen_txt_update();
         }
     }
@@ -198,88 +1766,233 @@ void screen_set_mode(uint8_t mode)
 //  Graphics functions
 //
 
-// Get the graphics frame buffer
+// Get the graphics frame buffer, once core 1 has finished drawing on it
 uint16_t *screen_gfx_frame()
 {
+    screen_gfx_fence();
     return gfx_buffer;
 }
 
+// Wait until core 1 has done every drawing command pushed so far, before
+// reading pixels back or using the LCD from core 0
+void screen_gfx_fence(void)
+{
+    if (queue_tail != queue_head)
+    {
+        uint32_t start = time_us_32();
+        while (queue_tail != queue_head)
+        {
+            tight_loop_contents();
+        }
+        gfx_waiting += time_us_32() - start;
+    }
+    __mem_fence_acquire();
+}
+
 // Clear the graphics buffer
 void screen_gfx_clear(void)
 {
-    memset(gfx_buffer, 0, sizeof(gfx_buffer)); // Clear the graphics buffer
+    push((gfx_command_t){.type = GFX_CMD_CLEAR, .rows = visible_rows(), .all = gfx_deferred});
+}
 
-    if (screen_mode == SCREEN_MODE_GFX)
+// Draw a point in the graphics buffer
+void screen_gfx_point(float x, float y, uint16_t colour, bool xor)
+{
+    if (!gfx_wrap && !screen_gfx_on_screen(x, y))
     {
-        lcd_clear_screen(); // Clear the LCD screen in graphics mode
+        return;
     }
-    else if (screen_mode == SCREEN_MODE_SPLIT)
+    push((gfx_command_t){.type = GFX_CMD_POINT, .xor = xor, .colour = colour, .x1 = x, .y1 = y});
+}
+
+// Draw a line in the graphics buffer, wrapping at the edges or clipped to
+// them. A line clipped away entirely is never queued for core 1.
+void screen_gfx_line(float x1, float y1, float x2, float y2, uint16_t colour, bool xor)
+{
+    if (!gfx_wrap && !clip_line(&x1, &y1, &x2, &y2, 0.0f))
     {
-        // Clear the graphics area in split mode
-        lcd_solid_rectangle(background, 0, 0, SCREEN_WIDTH, SCREEN_SPLIT_GFX_HEIGHT);
+        return;
     }
+    push((gfx_command_t){.type = GFX_CMD_LINE, .xor = xor, .colour = colour, .x1 = x1, .y1 = y1, .x2 = x2, .y2 = y2});
 }
 
-// Draw a point in the graphics buffer
-void screen_gfx_point(float x, float y, uint16_t colour, bool xor)
+// Draw a line with a pen a number of pixels wide, with round ends
+void screen_gfx_stroke(float x1, float y1, float x2, float y2, int width, uint16_t colour)
 {
-    int pixel_x = wrap_and_round(x, SCREEN_WIDTH);
-    int pixel_y = wrap_and_round(y, SCREEN_HEIGHT);
-
-    set_pixel(pixel_x, pixel_y, colour, xor);
+    if (!gfx_wrap && !clip_line(&x1, &y1, &x2, &y2, width / 2.0f + 1.0f))
+    {
+        return;
+    }
+    push((gfx_command_t){.type = GFX_CMD_STROKE,
+                         .colour = colour,
+                         .width = (uint8_t)width,
+                         .all = gfx_wrap,
+                         .x1 = x1,
+                         .y1 = y1,
+                         .x2 = x2,
+                         .y2 = y2});
 }
 
-// Draw a line in the graphics buffer using Bresenham's algorithm
-void screen_gfx_line(float x1, float y1, float x2, float y2, uint16_t colour, bool xor)
+// Draw an anti-aliased line, blended into the pixels along it
+void screen_gfx_smooth(float x1, float y1, float x2, float y2, uint16_t colour)
 {
-    // Calculate the number of steps based on the longest axis
-    float dx = x2 - x1;
-    float dy = y2 - y1;
-    int steps = (int)ceilf(fmaxf(fabsf(dx), fabsf(dy)));
+    if (!gfx_wrap && !clip_line(&x1, &y1, &x2, &y2, 1.0f))
+    {
+        return;
+    }
+    push((gfx_command_t){
+        .type = GFX_CMD_SMOOTH, .colour = colour, .all = gfx_wrap, .x1 = x1, .y1 = y1, .x2 = x2, .y2 = y2});
+}
 
-    if (steps == 0)
+// Flood fill the area of the colour at a point with another colour
+void screen_gfx_fill(float x, float y, uint16_t colour)
+{
+    if (!gfx_wrap && !screen_gfx_on_screen(x, y))
     {
-        // Single point
-        screen_gfx_point(x1, y1, colour, xor);
         return;
     }
+    push((gfx_command_t){.type = GFX_CMD_FILL, .colour = colour, .x1 = x, .y1 = y});
+}
 
-    float x_inc = dx / steps;
-    float y_inc = dy / steps;
+// Add a corner to the polygon to fill, or start a new polygon at it if first.
+// The corners are not wrapped onto the screen, so that each edge goes the
+// way the turtle went.
+void screen_gfx_vertex(float x, float y, bool first)
+{
+    push((gfx_command_t){.type = GFX_CMD_VERTEX, .all = first, .x1 = x, .y1 = y});
+}
 
-    float x = x1;
-    float y = y1;
+// Close the polygon and fill it
+void screen_gfx_polygon(uint16_t colour)
+{
+    push((gfx_command_t){.type = GFX_CMD_POLYGON, .colour = colour, .all = gfx_wrap});
+}
 
-    for (int i = 0; i <= steps; ++i)
-    {
-        int px = wrap_and_round(x, SCREEN_WIDTH);
-        int py = wrap_and_round(y, SCREEN_HEIGHT);
+// Draw an ellipse centred on a point, or fill it
+void screen_gfx_ellipse(float x, float y, float rx, float ry, uint16_t colour, bool filled)
+{
+    push((gfx_command_t){.type = GFX_CMD_ELLIPSE,
+                         .colour = colour,
+                         .filled = filled,
+                         .all = gfx_wrap,
+                         .x1 = x,
+                         .y1 = y,
+                         .x2 = rx,
+                         .y2 = ry});
+}
+
+// Draw an arc of a circle centred on a point, starting at a heading and
+// turning clockwise through an angle, both in degrees
+void screen_gfx_arc(float x, float y, float radius, float heading, float angle, uint16_t colour)
+{
+    push((gfx_command_t){.type = GFX_CMD_ARC,
+                         .colour = colour,
+                         .all = gfx_wrap,
+                         .x1 = x,
+                         .y1 = y,
+                         .x2 = radius,
+                         .y2 = heading,
+                         .angle = angle});
+}
 
-        set_pixel(px, py, colour, xor);
+// Wrap drawing at the edges of the screen, or clip it to them
+void screen_gfx_set_wrap(bool wrap)
+{
+    gfx_wrap = wrap;
+}
 
-        x += x_inc;
-        y += y_inc;
-    }
+// Get whether drawing wraps at the edges of the screen
+bool screen_gfx_get_wrap(void)
+{
+    return gfx_wrap;
+}
+
+// Check if a point rounds to a pixel on the screen without wrapping
+bool screen_gfx_on_screen(float x, float y)
+{
+    return x >= -0.5f && x < SCREEN_WIDTH - 0.5f && y >= -0.5f && y < SCREEN_HEIGHT - 0.5f;
 }
 
-// Write the frame buffer to the LCD display
+// Move, turn, recolour, show or hide one of the turtles drawn over the
+// graphics. It changes on the LCD at the next update.
+void screen_gfx_sprite(int index, float x, float y, float sine, float cosine, uint16_t colour, bool visible)
+{
+    gfx_sprite[index] = (gfx_sprite_t){x, y, sine, cosine, colour, visible};
+}
+
+// Write the parts of the frame buffer drawn on since the last update to
+// the LCD display, after the drawing already queued, unless updates are
+// deferred
 void screen_gfx_update(void)
 {
-    if (screen_mode == SCREEN_MODE_GFX)
+    if (!gfx_deferred)
     {
-        lcd_blit(gfx_buffer, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+        screen_gfx_present();
     }
-    else if (screen_mode == SCREEN_MODE_SPLIT)
+}
+
+// Update the display if SCREEN_FRAME_US has passed since the last update.
+// Drawing only changes the frame buffer, so a running program calls this
+// now and then to show its progress; the REPL updates after every line.
+void screen_gfx_refresh(void)
+{
+    if (time_us_32() - gfx_updated >= SCREEN_FRAME_US)
     {
-        // Blit the graphics area only
-        lcd_blit(gfx_buffer, 0, 0, SCREEN_WIDTH, SCREEN_SPLIT_GFX_HEIGHT);
+        screen_gfx_update();
     }
-    // In text mode, we don't update the display
+}
+
+// Write the parts of the frame buffer drawn on since the last update to
+// the LCD display, even if updates are deferred
+void screen_gfx_present(void)
+{
+    gfx_updated = time_us_32();
+    if (screen_mode != SCREEN_MODE_TXT) // In text mode, we don't update the display
+    {
+        push_update(false);
+    }
+}
+
+// Defer updates until screen_gfx_present is called, or go back to updating
+// after every line and while a program runs. A program can then draw each
+// frame of an animation whole, and large drawings go at the speed of the
+// frame buffer rather than the LCD.
+void screen_gfx_defer(bool defer)
+{
+    gfx_deferred = defer;
+    if (!defer)
+    {
+        screen_gfx_present();
+    }
+}
+
+// Report the updates that sent anything to the LCD, and the blits they
+// took, since the last report
+void screen_gfx_stats(uint32_t *frames, uint32_t *blits)
+{
+    screen_gfx_fence();
+    *frames = gfx_frames;
+    *blits = gfx_blits;
+    gfx_frames = 0;
+    gfx_blits = 0;
+}
+
+// Report the microseconds core 1 spent drawing, and core 0 spent waiting
+// for it, since the last report
+void screen_gfx_times(uint32_t *drawing, uint32_t *waiting)
+{
+    screen_gfx_fence();
+    *drawing = gfx_drawing;
+    *waiting = gfx_waiting;
+    gfx_drawing = 0;
+    gfx_waiting = 0;
 }
 
 int screen_gfx_save(const char *filename)
 {
-    // Save the current graphics buffer to a BMP file (16-bit RGB565)
+    // Save the current graphics buffer to a BMP file (16-bit RGB565). The
+    // frame waits for core 1 to finish drawing and to take the turtles off.
+    const uint16_t *frame = screen_gfx_frame();
     FILE *fp = fopen(filename, "wb");
     if (!fp)
     {
@@ -338,7 +2051,7 @@ int screen_gfx_save(const char *filename)
     for (int y = SCREEN_HEIGHT - 1; y >= 0; y--)
     {
         fwrite(
-            gfx_buffer + y * SCREEN_WIDTH,
+            frame + y * SCREEN_WIDTH,
             BMP_BYTES_PER_PIXEL,
             SCREEN_WIDTH,
             fp);
@@ -362,6 +2075,7 @@ uint16_t *screen_txt_frame()
 // Clear the text buffer
 void screen_txt_clear(void)
 {
+    screen_gfx_fence();
     text_row = 0;                              // Reset the text row to the top
     memset(txt_buffer, 0, sizeof(txt_buffer)); // Clear the text buffer
 
@@ -383,6 +2097,7 @@ void screen_txt_set_font(const font_t *font)
     {
         screen_font = font;
         txt_line_font[cursor_row] = (screen_font == &font_5x10); // Set the font for the last row
+        screen_gfx_fence();
         lcd_set_font(font);
     }
 }
@@ -402,6 +2117,7 @@ void screen_txt_set_cursor(uint8_t column, uint8_t row)
     cursor_row = row < SCREEN_ROWS ? row : SCREEN_ROWS - 1; // Ensure row is within bounds
 
     screen_txt_map_location(&column, &row);
+    screen_gfx_fence();
     lcd_move_cursor(column, row);
 }
 
@@ -421,6 +2137,7 @@ void screen_txt_get_cursor(uint8_t *column, uint8_t *row)
 // Enable or disable the cursor in text mode
 void screen_txt_enable_cursor(bool cursor_on)
 {
+    screen_gfx_fence();
     if (screen_txt_map_location(NULL, NULL))
     {
         cursor_enabled = cursor_on;   // Set the cursor visibility state
@@ -441,6 +2158,7 @@ void screen_txt_draw_cursor(void)
     if (screen_txt_map_location(&column, &row))
     {
         // The cursor is visible, we can draw it
+        screen_gfx_fence();
         lcd_move_cursor(column, row); // Move the cursor to the current position
         lcd_draw_cursor();            // Draw the cursor at the current position
     }
@@ -453,6 +2171,7 @@ void screen_txt_erase_cursor(void)
     if (screen_txt_map_location(&column, &row))
     {
         // The cursor is visible, we can draw it
+        screen_gfx_fence();
         lcd_move_cursor(column, row); // Move the cursor to the current position
         lcd_erase_cursor();           // Draw the cursor at the current position
     }
@@ -464,6 +2183,7 @@ bool screen_txt_putc(uint8_t c)
 {
     uint8_t columns = SCREEN_WIDTH / screen_font->width; // Calculate the number of columns based on font width
     bool scrolled = false;
+    screen_gfx_fence(); // The LCD may be written below
     if (c == '\n' || c == '\r')
     {
         txt_line_font[cursor_row] = (screen_font == &font_5x10);
@@ -643,6 +2363,7 @@ bool screen_txt_puts(const char *str)
 // Write the text buffer to the LCD display
 void screen_txt_update(void)
 {
+    screen_gfx_fence();
     bool cursor_enabled = lcd_cursor_enabled(); // Save the current cursor state
     lcd_enable_cursor(false);                   // Disable the cursor while updating
 
@@ -709,8 +2430,9 @@ void screen_txt_update(void)
 // Initialize the screen
 void screen_init()
 {
-    // Initialize the display
+    // Initialize the display, and start core 1 drawing on it
     lcd_init();
+    multicore_launch_core1(gfx_core1);
 
     // Set for a default of split screen
     screen_set_mode(SCREEN_MODE_TXT);
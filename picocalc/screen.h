@@ -48,6 +48,62 @@
 #define BMP_FILE_SIZE (BMP_FILE_HEADER_SIZE + BMP_DIB_HEADER_SIZE + BMP_PIXEL_DATA_SIZE)
 #define BMP_PIXEL_DATA_OFFSET (BMP_FILE_HEADER_SIZE + BMP_DIB_HEADER_SIZE + BMP_COLOR_MASKS_SIZE)
 
+// Line definitions
+#define LINE_FRACTION_BITS (32)         // Fraction bits of a fixed-point line coordinate
+#define LINE_FIXED_MIN (1.0f / 512.0f)  // Smallest magnitude whose float grid fits in the fraction bits
+#define LINE_COORD_MAX (1073741824.0f)  // Largest coordinate stepped in fixed point (2^30)
+#define LINE_CLIP_INSET (1.0f / 16.0f) // Distance inside the edge pixels that lines are clipped to when not wrapping
+
+// Update definitions
+#define SCREEN_FRAME_US (20000) // Shortest time between updates while a program runs (50Hz)
+
+// Drawing queue definitions
+#define GFX_QUEUE_SIZE (128) // Drawing commands waiting for core 1, a power of two
+#define GFX_CMD_LINE (0)     // Draw a line
+#define GFX_CMD_POINT (1)    // Draw a point
+#define GFX_CMD_CLEAR (2)    // Clear the graphics buffer and LCD
+#define GFX_CMD_UPDATE (3)   // Send the dirty tiles to the LCD, with the turtles drawn over them
+#define GFX_CMD_FILL (4)     // Flood fill from a point
+#define GFX_CMD_VERTEX (5)   // Add a corner to the polygon, or start a new one
+#define GFX_CMD_POLYGON (6)  // Fill the polygon
+#define GFX_CMD_ELLIPSE (7)  // Draw or fill an ellipse
+#define GFX_CMD_ARC (8)      // Draw an arc of a circle
+#define GFX_CMD_STROKE (9)   // Draw a line with a wide pen
+#define GFX_CMD_SMOOTH (10)  // Draw an anti-aliased line
+#define GFX_CMD_SPRITE (11)  // Move a turtle, to be shown at the next UPDATE
+
+// Fill definitions
+#define FILL_STACK (256) // Runs of pixels a flood fill has waiting to be scanned
+#ifndef FILL_CORNERS
+#define FILL_CORNERS (128) // Most corners of a filled polygon, including the one closing it, override from CMake
+#endif
+
+// Shape definitions
+#define SHAPE_RADIUS_MAX (32767) // Largest radius of a circle, ellipse or arc, in pixels
+
+// Smooth line definitions
+#define SMOOTH_FRACTION_BITS (16)                  // Fraction bits of the position across a smooth line
+#define SMOOTH_ONE (1 << SMOOTH_FRACTION_BITS)     // One pixel across a smooth line, in fixed point
+#define SMOOTH_COVERAGE_BITS (5)                   // Bits of the coverage a pixel is blended by
+#define SMOOTH_OPAQUE (1u << SMOOTH_COVERAGE_BITS) // Coverage of a pixel the line passes through the centre of
+#define SMOOTH_CHANNELS (0x07E0F81Fu)              // Green, red and blue of an RGB565 pixel spread across a word
+
+// Turtle sprite definitions
+#ifndef SPRITE_COUNT
+#define SPRITE_COUNT (16) // Turtles that can be drawn over the graphics, override from CMake
+#endif
+#define SPRITE_HALF_BASE (4.0f)            // Half the base width of the turtle triangle
+#define SPRITE_HEIGHT (12.0f)              // Height of the turtle triangle
+#define SPRITE_RADIUS (13)                 // Pixels from the turtle to the edge of the box it is drawn in
+#define SPRITE_BOX (2 * SPRITE_RADIUS + 1) // Width and height of the box the turtle is drawn in
+
+// Dirty tile definitions
+#define GFX_TILE_SHIFT (4)                                       // Tiles are 16x16 pixels
+#define GFX_TILE_SIZE (1 << GFX_TILE_SHIFT)                      // Width and height of a tile in pixels
+#define GFX_TILE_COLUMNS (SCREEN_WIDTH / GFX_TILE_SIZE)          // Tiles across the screen, one bit each in a row mask
+#define GFX_TILE_ROWS (SCREEN_HEIGHT / GFX_TILE_SIZE)            // Tiles down the screen
+#define GFX_TILES_ALL ((uint32_t)(1ull << GFX_TILE_COLUMNS) - 1) // Row mask with every tile dirty
+
 // Function prototypes
 
 // Screen mode functions (TXT, GFX, SPLIT)
@@ -56,10 +112,27 @@ void screen_set_mode(uint8_t mode);
 
 // Graphics functions
 uint16_t *screen_gfx_frame();
+void screen_gfx_fence(void);
 void screen_gfx_clear(void);
 void screen_gfx_point(float x, float y, uint16_t colour, bool xor);
 void screen_gfx_line(float x1, float y1, float x2, float y2, uint16_t colour, bool xor);
+void screen_gfx_stroke(float x1, float y1, float x2, float y2, int width, uint16_t colour);
+void screen_gfx_smooth(float x1, float y1, float x2, float y2, uint16_t colour);
+void screen_gfx_fill(float x, float y, uint16_t colour);
+void screen_gfx_vertex(float x, float y, bool first);
+void screen_gfx_polygon(uint16_t colour);
+void screen_gfx_ellipse(float x, float y, float rx, float ry, uint16_t colour, bool filled);
+void screen_gfx_arc(float x, float y, float radius, float heading, float angle, uint16_t colour);
+void screen_gfx_set_wrap(bool wrap);
+bool screen_gfx_get_wrap(void);
+bool screen_gfx_on_screen(float x, float y);
+void screen_gfx_sprite(int index, float x, float y, float sine, float cosine, uint16_t colour, bool visible);
 void screen_gfx_update(void);
+void screen_gfx_refresh(void);
+void screen_gfx_present(void);
+void screen_gfx_defer(bool defer);
+void screen_gfx_stats(uint32_t *frames, uint32_t *blits);
+void screen_gfx_times(uint32_t *drawing, uint32_t *waiting);
 int screen_gfx_save(const char *filename);
 
 // Text functions
@@ -0,0 +1,483 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+//
+//  Picture
+//
+//  While recording, the turtle adds what it draws to a display list in a
+//  fixed arena, so a scene can be drawn again, saved to the SD card and
+//  loaded back without running the program that drew it. Replaying sends
+//  the records straight to the screen, with no interpreter in between.
+//
+//  Each record is an opcode byte and its operands, little-endian, with
+//  points as two floats. A line starts where the turtle was left by the
+//  last one, its end wrapped by turtle_settle, unless a MOVE says
+//  otherwise, and the colour, the pen width and whether drawing wraps are
+//  only recorded when they change, so a path costs nine bytes a line.
+//
+//  If the arena fills, recording stops and the picture cannot be replayed
+//  or saved until recording starts again.
+//
+//  A file is a header of PICTURE_MAGIC, the version as 16 bits, 16 bits
+//  reserved and the length of the records as 32 bits, then the records.
+//  Loading checks every record fits before any is drawn.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "picture.h"
+#include "picocalc/screen.h"
+#include "turtle.h"
+
+// Bytes of operands after each opcode
+static const uint8_t picture_operands[PICTURE_OPS] = {
+    [PICTURE_OP_CLEAR] = 0,
+    [PICTURE_OP_COLOUR] = 2,
+    [PICTURE_OP_WRAP] = 1,
+    [PICTURE_OP_WIDTH] = 1,
+    [PICTURE_OP_MOVE] = 8,
+    [PICTURE_OP_LINE] = 8,
+    [PICTURE_OP_SMOOTH] = 8,
+    [PICTURE_OP_STROKE] = 8,
+    [PICTURE_OP_FILL] = 8,
+    [PICTURE_OP_BEGIN] = 8,
+    [PICTURE_OP_VERTEX] = 8,
+    [PICTURE_OP_POLYGON] = 0,
+    [PICTURE_OP_ELLIPSE] = 16,
+    [PICTURE_OP_FILLED] = 16,
+    [PICTURE_OP_ARC] = 20,
+};
+
+static uint8_t picture_list[PICTURE_SIZE]; // The records
+static uint32_t picture_length = 0;        // Bytes of records in picture_list
+static bool picture_recording = false;     // The turtle's drawing is being added
+static bool picture_full = false;          // Recording stopped when the arena filled
+static int32_t picture_colour = -1;        // Colour last recorded, or -1 if none
+static int32_t picture_wrap = -1;          // Wrapping last recorded, or -1 if none
+static int32_t picture_width = -1;         // Pen width last recorded, or -1 if none
+static float picture_x = NAN;              // Where the last line recorded left the turtle
+static float picture_y = NAN;              // Where the last line recorded left the turtle
+
+//
+//  Helper functions
+//
+
+// Forget the state last recorded, so the next record of each is added
+static void picture_forget(void)
+{
+    picture_colour = -1;
+    picture_wrap = -1;
+    picture_width = -1;
+    picture_x = NAN;
+    picture_y = NAN;
+}
+
+// Add the opcode of a record, returning where its operands go, or NULL if
+// it does not fit, which stops recording
+static uint8_t *picture_op(uint8_t op)
+{
+    uint32_t size = 1 + picture_operands[op];
+    if (picture_length + size > PICTURE_SIZE)
+    {
+        picture_recording = false;
+        picture_full = true;
+        return NULL;
+    }
+    uint8_t *record = picture_list + picture_length;
+    picture_length += size;
+    *record = op;
+    return record + 1;
+}
+
+// Add a record whose operands are floats
+static void picture_floats(uint8_t op, const float *values, int count)
+{
+    uint8_t *operands = picture_op(op);
+    if (operands)
+    {
+        memcpy(operands, values, count * sizeof(float));
+    }
+}
+
+// Add a record whose operand is one byte
+static void picture_byte(uint8_t op, uint8_t value)
+{
+    uint8_t *operands = picture_op(op);
+    if (operands)
+    {
+        operands[0] = value;
+    }
+}
+
+// Record the colour something is drawn in, and whether it wraps, if
+// either has changed
+static void picture_state(uint16_t colour)
+{
+    int32_t wrap = screen_gfx_get_wrap();
+    if (wrap != picture_wrap)
+    {
+        picture_wrap = wrap;
+        picture_byte(PICTURE_OP_WRAP, (uint8_t)wrap);
+    }
+    if (colour != picture_colour)
+    {
+        picture_colour = colour;
+        uint8_t *operands = picture_op(PICTURE_OP_COLOUR);
+        if (operands)
+        {
+            operands[0] = colour & 0xFF;
+            operands[1] = colour >> 8;
+        }
+    }
+}
+
+// Record a line, moving to its start first if the last one left the
+// turtle elsewhere
+static void picture_segment(uint8_t op, float x1, float y1, float x2, float y2, uint16_t colour)
+{
+    picture_state(colour);
+    if (x1 != picture_x || y1 != picture_y)
+    {
+        picture_floats(PICTURE_OP_MOVE, (float[]){x1, y1}, 2);
+    }
+    picture_floats(op, (float[]){x2, y2}, 2);
+    picture_x = turtle_settle(x2, SCREEN_WIDTH, picture_wrap);
+    picture_y = turtle_settle(y2, SCREEN_HEIGHT, picture_wrap);
+}
+
+// Read the float operand at an index of a record
+static float picture_float(const uint8_t *operands, int index)
+{
+    float value;
+    memcpy(&value, operands + index * sizeof(float), sizeof(float));
+    return value;
+}
+
+// Check that the records are whole and have known opcodes
+static bool picture_check(void)
+{
+    uint32_t at = 0;
+    while (at < picture_length)
+    {
+        uint8_t op = picture_list[at];
+        if (op >= PICTURE_OPS)
+        {
+            return false;
+        }
+        at += 1 + picture_operands[op];
+    }
+    return at == picture_length;
+}
+
+// Write a number of bytes, little-endian
+static void put_le(uint8_t *bytes, uint32_t value, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        bytes[i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+// Read a number of bytes, little-endian
+static uint32_t get_le(const uint8_t *bytes, int count)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < count; i++)
+    {
+        value |= (uint32_t)bytes[i] << (8 * i);
+    }
+    return value;
+}
+
+//
+//  Recording
+//
+
+// Start recording the turtle's drawing into an empty picture
+void picture_record(void)
+{
+    picture_length = 0;
+    picture_full = false;
+    picture_recording = true;
+    picture_forget();
+}
+
+// Stop recording, keeping the picture
+void picture_stop(void)
+{
+    picture_recording = false;
+}
+
+// Record clearing the screen
+void picture_add_clear(void)
+{
+    if (picture_recording)
+    {
+        picture_op(PICTURE_OP_CLEAR);
+    }
+}
+
+// Record a line
+void picture_add_line(float x1, float y1, float x2, float y2, uint16_t colour)
+{
+    if (picture_recording)
+    {
+        picture_segment(PICTURE_OP_LINE, x1, y1, x2, y2, colour);
+    }
+}
+
+// Record an anti-aliased line
+void picture_add_smooth(float x1, float y1, float x2, float y2, uint16_t colour)
+{
+    if (picture_recording)
+    {
+        picture_segment(PICTURE_OP_SMOOTH, x1, y1, x2, y2, colour);
+    }
+}
+
+// Record a line drawn with a wide pen
+void picture_add_stroke(float x1, float y1, float x2, float y2, int width, uint16_t colour)
+{
+    if (picture_recording)
+    {
+        if (width != picture_width)
+        {
+            picture_width = width;
+            picture_byte(PICTURE_OP_WIDTH, (uint8_t)width);
+        }
+        picture_segment(PICTURE_OP_STROKE, x1, y1, x2, y2, colour);
+    }
+}
+
+// Record a flood fill
+void picture_add_fill(float x, float y, uint16_t colour)
+{
+    if (picture_recording)
+    {
+        picture_state(colour);
+        picture_floats(PICTURE_OP_FILL, (float[]){x, y}, 2);
+    }
+}
+
+// Record a corner of a polygon to fill, or the first one
+void picture_add_vertex(float x, float y, bool first)
+{
+    if (picture_recording)
+    {
+        picture_floats(first ? PICTURE_OP_BEGIN : PICTURE_OP_VERTEX, (float[]){x, y}, 2);
+    }
+}
+
+// Record filling the polygon
+void picture_add_polygon(uint16_t colour)
+{
+    if (picture_recording)
+    {
+        picture_state(colour);
+        picture_op(PICTURE_OP_POLYGON);
+    }
+}
+
+// Record an ellipse, drawn or filled
+void picture_add_ellipse(float x, float y, float rx, float ry, uint16_t colour, bool filled)
+{
+    if (picture_recording)
+    {
+        picture_state(colour);
+        picture_floats(filled ? PICTURE_OP_FILLED : PICTURE_OP_ELLIPSE, (float[]){x, y, rx, ry}, 4);
+    }
+}
+
+// Record an arc
+void picture_add_arc(float x, float y, float radius, float heading, float angle, uint16_t colour)
+{
+    if (picture_recording)
+    {
+        picture_state(colour);
+        picture_floats(PICTURE_OP_ARC, (float[]){x, y, radius, heading, angle}, 5);
+    }
+}
+
+//
+//  Replaying, saving and loading
+//
+
+// Draw the picture again. The screen is left wrapping as it was.
+int picture_replay(void)
+{
+    if (picture_full)
+    {
+        return PICTURE_FULL;
+    }
+
+    bool wrap = screen_gfx_get_wrap();
+    bool wrapping = wrap;
+    uint16_t colour = 0xFFFF;
+    int width = 1;
+    float x = 0.0f;
+    float y = 0.0f;
+    for (uint32_t at = 0; at < picture_length; at += 1 + picture_operands[picture_list[at]])
+    {
+        uint8_t op = picture_list[at];
+        const uint8_t *operands = picture_list + at + 1;
+        switch (op)
+        {
+        case PICTURE_OP_CLEAR:
+            screen_gfx_clear();
+            break;
+
+        case PICTURE_OP_COLOUR:
+            colour = (uint16_t)get_le(operands, 2);
+            break;
+
+        case PICTURE_OP_WRAP:
+            wrapping = operands[0];
+            screen_gfx_set_wrap(wrapping);
+            break;
+
+        case PICTURE_OP_WIDTH:
+            width = operands[0];
+            break;
+
+        case PICTURE_OP_MOVE:
+            x = picture_float(operands, 0);
+            y = picture_float(operands, 1);
+            break;
+
+        case PICTURE_OP_LINE:
+        case PICTURE_OP_SMOOTH:
+        case PICTURE_OP_STROKE:
+        {
+            float x2 = picture_float(operands, 0);
+            float y2 = picture_float(operands, 1);
+            if (op == PICTURE_OP_LINE)
+            {
+                screen_gfx_line(x, y, x2, y2, colour, false);
+            }
+            else if (op == PICTURE_OP_SMOOTH)
+            {
+                screen_gfx_smooth(x, y, x2, y2, colour);
+            }
+            else
+            {
+                screen_gfx_stroke(x, y, x2, y2, width, colour);
+            }
+            x = turtle_settle(x2, SCREEN_WIDTH, wrapping);
+            y = turtle_settle(y2, SCREEN_HEIGHT, wrapping);
+            break;
+        }
+
+        case PICTURE_OP_FILL:
+            screen_gfx_fill(picture_float(operands, 0), picture_float(operands, 1), colour);
+            break;
+
+        case PICTURE_OP_BEGIN:
+        case PICTURE_OP_VERTEX:
+            screen_gfx_vertex(picture_float(operands, 0), picture_float(operands, 1), op == PICTURE_OP_BEGIN);
+            break;
+
+        case PICTURE_OP_POLYGON:
+            screen_gfx_polygon(colour);
+            break;
+
+        case PICTURE_OP_ELLIPSE:
+        case PICTURE_OP_FILLED:
+            screen_gfx_ellipse(picture_float(operands, 0), picture_float(operands, 1), picture_float(operands, 2),
+                               picture_float(operands, 3), colour, op == PICTURE_OP_FILLED);
+            break;
+
+        case PICTURE_OP_ARC:
+            screen_gfx_arc(picture_float(operands, 0), picture_float(operands, 1), picture_float(operands, 2),
+                           picture_float(operands, 3), picture_float(operands, 4), colour);
+            break;
+        }
+    }
+
+    screen_gfx_set_wrap(wrap);
+    screen_gfx_update();
+    return PICTURE_OK;
+}
+
+// Save the picture to a file
+int picture_save(const char *filename)
+{
+    if (picture_full)
+    {
+        return PICTURE_FULL;
+    }
+
+    FILE *fp = fopen(filename, "wb");
+    if (!fp)
+    {
+        return PICTURE_NO_FILE;
+    }
+
+    uint8_t header[PICTURE_HEADER_SIZE] = {0};
+    memcpy(header, PICTURE_MAGIC, 4);
+    put_le(header + 4, PICTURE_VERSION, 2);
+    put_le(header + 8, picture_length, 4);
+    bool written = fwrite(header, 1, PICTURE_HEADER_SIZE, fp) == PICTURE_HEADER_SIZE &&
+                   fwrite(picture_list, 1, picture_length, fp) == picture_length;
+    written = fclose(fp) == 0 && written;
+
+    return written ? PICTURE_OK : PICTURE_NO_FILE;
+}
+
+// Load a picture from a file in place of the one recorded. Recording, if
+// it is on, carries on after the picture loaded. If the file cannot be
+// loaded the picture is left empty.
+int picture_load(const char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (!fp)
+    {
+        return PICTURE_NO_FILE;
+    }
+
+    picture_length = 0;
+    picture_full = false;
+    picture_forget();
+
+    uint8_t header[PICTURE_HEADER_SIZE];
+    int result = PICTURE_OK;
+    if (fread(header, 1, PICTURE_HEADER_SIZE, fp) != PICTURE_HEADER_SIZE ||
+        memcmp(header, PICTURE_MAGIC, 4) != 0)
+    {
+        result = PICTURE_BAD_FILE;
+    }
+    else if (get_le(header + 4, 2) == 0 || get_le(header + 4, 2) > PICTURE_VERSION)
+    {
+        result = PICTURE_NEWER;
+    }
+    else
+    {
+        uint32_t length = get_le(header + 8, 4);
+        if (length > PICTURE_SIZE)
+        {
+            result = PICTURE_FULL;
+        }
+        else if (fread(picture_list, 1, length, fp) != length)
+        {
+            result = PICTURE_BAD_FILE;
+        }
+        else
+        {
+            picture_length = length;
+            if (!picture_check())
+            {
+                picture_length = 0;
+                result = PICTURE_BAD_FILE;
+            }
+        }
+    }
+
+    fclose(fp);
+    return result;
+}
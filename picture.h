@@ -0,0 +1,62 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+// Picture limits, override from CMake to size them for the board
+#ifndef PICTURE_SIZE
+#define PICTURE_SIZE (32768) // Bytes for the drawing recorded in the picture
+#endif
+
+// Picture file definitions
+#define PICTURE_MAGIC "LPIC"     // First bytes of a picture file
+#define PICTURE_VERSION (1)      // Version of the format written, and the newest read
+#define PICTURE_HEADER_SIZE (12) // Magic, version, reserved and length, in bytes
+
+// Picture records, each an opcode byte followed by its operands
+#define PICTURE_OP_CLEAR (0)    // Clear the screen
+#define PICTURE_OP_COLOUR (1)   // Draw in a colour (16 bits)
+#define PICTURE_OP_WRAP (2)     // Wrap at the edges, or clip to them (8 bits)
+#define PICTURE_OP_WIDTH (3)    // Draw wide lines with a pen this wide (8 bits)
+#define PICTURE_OP_MOVE (4)     // Move to a point without drawing (x, y)
+#define PICTURE_OP_LINE (5)     // Draw a line to a point (x, y)
+#define PICTURE_OP_SMOOTH (6)   // Draw an anti-aliased line to a point (x, y)
+#define PICTURE_OP_STROKE (7)   // Draw a wide line to a point (x, y)
+#define PICTURE_OP_FILL (8)     // Flood fill from a point (x, y)
+#define PICTURE_OP_BEGIN (9)    // Start a polygon at a corner (x, y)
+#define PICTURE_OP_VERTEX (10)  // Add a corner to the polygon (x, y)
+#define PICTURE_OP_POLYGON (11) // Fill the polygon
+#define PICTURE_OP_ELLIPSE (12) // Draw an ellipse (x, y, rx, ry)
+#define PICTURE_OP_FILLED (13)  // Fill an ellipse (x, y, rx, ry)
+#define PICTURE_OP_ARC (14)     // Draw an arc (x, y, radius, heading, angle)
+#define PICTURE_OPS (15)        // Number of opcodes
+
+// Picture results
+#define PICTURE_OK (0)       // Done
+#define PICTURE_FULL (1)     // The drawing did not fit in PICTURE_SIZE
+#define PICTURE_NO_FILE (2)  // The file could not be opened, read or written
+#define PICTURE_BAD_FILE (3) // The file is not a picture, or is damaged
+#define PICTURE_NEWER (4)    // The file is from a newer version
+
+// Recording
+void picture_record(void);
+void picture_stop(void);
+void picture_add_clear(void);
+void picture_add_line(float x1, float y1, float x2, float y2, uint16_t colour);
+void picture_add_smooth(float x1, float y1, float x2, float y2, uint16_t colour);
+void picture_add_stroke(float x1, float y1, float x2, float y2, int width, uint16_t colour);
+void picture_add_fill(float x, float y, uint16_t colour);
+void picture_add_vertex(float x, float y, bool first);
+void picture_add_polygon(uint16_t colour);
+void picture_add_ellipse(float x, float y, float rx, float ry, uint16_t colour, bool filled);
+void picture_add_arc(float x, float y, float radius, float heading, float angle, uint16_t colour);
+
+// Replaying, saving and loading
+int picture_replay(void);
+int picture_save(const char *filename);
+int picture_load(const char *filename);
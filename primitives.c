@@ -0,0 +1,948 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+#include <ctype.h>
+#include <stdio.h>
+#include <strings.h>
+
+#include "pico/stdlib.h"
+#include "pico/rand.h"
+
+#include "evaluate.h"
+#include "heap.h"
+#include "picture.h"
+#include "primitives.h"
+#include "primitives_hash.h"
+#include "symbols.h"
+#include "turtle.h"
+#include "vm.h"
+
+void print_version(void);
+void print_license(void);
+
+static char scratch[HEAP_WORD_MAX + 1]; // Text of the word being worked on
+
+//
+//  Helper functions
+//
+
+// Get inputs that must be numbers, or set the error for the first that is not
+static int numbers(const char *name, const value_t *inputs, int count, float *values)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (!value_to_number(inputs[i], &values[i]))
+        {
+            return value_error(name, inputs[i]);
+        }
+    }
+    return EVAL_STATE_COMPLETE;
+}
+
+// Get inputs that must be whole numbers, dropping any fraction
+static int integers(const char *name, const value_t *inputs, int count, int32_t *values)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (!value_to_integer(inputs[i], &values[i]))
+        {
+            return value_error(name, inputs[i]);
+        }
+    }
+    return EVAL_STATE_COMPLETE;
+}
+
+// Apply an arithmetic or comparison opcode as the VM does for infix
+static int arithmetic(const char *name, uint8_t op, const value_t *inputs, value_t *output)
+{
+    if (vm_arithmetic(op, inputs[0], inputs[1], output))
+    {
+        return EVAL_STATE_COMPLETE;
+    }
+    float n[2];
+    int state = numbers(name, inputs, 2, n);
+    if (state != EVAL_STATE_COMPLETE)
+    {
+        return state;
+    }
+    return evaluate_error("%s doesn't like 0 as input", name);
+}
+
+// Output a new word
+static int output_word(const char *text, uint16_t length, value_t *output)
+{
+    if (!heap_reserve(heap_text_nodes(length)))
+    {
+        return EVAL_STATE_ERROR;
+    }
+    *output = heap_word(text, length);
+    return EVAL_STATE_COMPLETE;
+}
+
+// Number of elements in a list
+static uint16_t list_length(value_t list)
+{
+    uint16_t length = 0;
+    for (uint16_t node = list.node; node != HEAP_NIL; node = heap_nodes[node].rest)
+    {
+        length++;
+    }
+    return length;
+}
+
+// Copy the first count elements of a list, ending with the given rest.
+// The nodes must have been reserved.
+static uint16_t list_copy(value_t list, uint16_t count, uint16_t rest)
+{
+    uint16_t first = rest;
+    uint16_t last = HEAP_NIL;
+    for (uint16_t node = list.node; count--; node = heap_nodes[node].rest)
+    {
+        uint16_t copy = heap_cons(heap_nodes[node].first, rest);
+        if (last == HEAP_NIL)
+        {
+            first = copy;
+        }
+        else
+        {
+            heap_nodes[last].rest = copy;
+        }
+        last = copy;
+    }
+    return first;
+}
+
+//
+//  Turtle primitives
+//
+
+static int prim_forward(const value_t *inputs, value_t *output)
+{
+    float distance;
+    int state = numbers("forward", inputs, 1, &distance);
+    if (state != EVAL_STATE_COMPLETE)
+    {
+        return state;
+    }
+    if (!turtle_move(distance))
+    {
+        return evaluate_error("Turtle out of bounds");
+    }
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_back(const value_t *inputs, value_t *output)
+{
+    float distance;
+    int state = numbers("back", inputs, 1, &distance);
+    if (state != EVAL_STATE_COMPLETE)
+    {
+        return state;
+    }
+    if (!turtle_move(-distance))
+    {
+        return evaluate_error("Turtle out of bounds");
+    }
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_right(const value_t *inputs, value_t *output)
+{
+    float angle;
+    int state = numbers("right", inputs, 1, &angle);
+    if (state != EVAL_STATE_COMPLETE)
+    {
+        return state;
+    }
+    turtle_turn(angle);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_left(const value_t *inputs, value_t *output)
+{
+    float angle;
+    int state = numbers("left", inputs, 1, &angle);
+    if (state != EVAL_STATE_COMPLETE)
+    {
+        return state;
+    }
+    turtle_turn(-angle);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_setcolor(const value_t *inputs, value_t *output)
+{
+    int32_t colour;
+    int state = integers("setcolor", inputs, 1, &colour);
+    if (state != EVAL_STATE_COMPLETE)
+    {
+        return state;
+    }
+    turtle_set_colour((uint16_t)colour);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_home(const value_t *inputs, value_t *output)
+{
+    turtle_home();
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_clearscreen(const value_t *inputs, value_t *output)
+{
+    turtle_clearscreen();
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_penup(const value_t *inputs, value_t *output)
+{
+    turtle_set_pen_down(false);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_pendown(const value_t *inputs, value_t *output)
+{
+    turtle_set_pen_down(true);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_setpensize(const value_t *inputs, value_t *output)
+{
+    int32_t size;
+    int state = integers("setpensize", inputs, 1, &size);
+    if (state != EVAL_STATE_COMPLETE)
+    {
+        return state;
+    }
+    if (size < 1 || size > TURTLE_PEN_SIZE_MAX)
+    {
+        return value_error("setpensize", inputs[0]);
+    }
+    turtle_set_pen_size(size);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_pensize(const value_t *inputs, value_t *output)
+{
+    *output = value_integer(turtle_get_pen_size());
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_setsmooth(const value_t *inputs, value_t *output)
+{
+    bool smooth;
+    if (!value_to_bool(inputs[0], &smooth))
+    {
+        return value_error("setsmooth", inputs[0]);
+    }
+    turtle_set_smooth(smooth);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_smoothp(const value_t *inputs, value_t *output)
+{
+    *output = value_bool(turtle_get_smooth());
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_showturtle(const value_t *inputs, value_t *output)
+{
+    turtle_set_visibility(true);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_hideturtle(const value_t *inputs, value_t *output)
+{
+    turtle_set_visibility(false);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_fill(const value_t *inputs, value_t *output)
+{
+    turtle_fill();
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_beginfill(const value_t *inputs, value_t *output)
+{
+    turtle_begin_fill();
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_endfill(const value_t *inputs, value_t *output)
+{
+    if (!turtle_end_fill())
+    {
+        return evaluate_error("Too many corners to fill, the most is %d", FILL_CORNERS - 1);
+    }
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_circle(const value_t *inputs, value_t *output)
+{
+    float radius;
+    int state = numbers("circle", inputs, 1, &radius);
+    if (state != EVAL_STATE_COMPLETE)
+    {
+        return state;
+    }
+    turtle_ellipse(radius, radius, false);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_filledcircle(const value_t *inputs, value_t *output)
+{
+    float radius;
+    int state = numbers("filledcircle", inputs, 1, &radius);
+    if (state != EVAL_STATE_COMPLETE)
+    {
+        return state;
+    }
+    turtle_ellipse(radius, radius, true);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_ellipse(const value_t *inputs, value_t *output)
+{
+    float radii[2];
+    int state = numbers("ellipse", inputs, 2, radii);
+    if (state != EVAL_STATE_COMPLETE)
+    {
+        return state;
+    }
+    turtle_ellipse(radii[0], radii[1], false);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_filledellipse(const value_t *inputs, value_t *output)
+{
+    float radii[2];
+    int state = numbers("filledellipse", inputs, 2, radii);
+    if (state != EVAL_STATE_COMPLETE)
+    {
+        return state;
+    }
+    turtle_ellipse(radii[0], radii[1], true);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_arc(const value_t *inputs, value_t *output)
+{
+    float values[2];
+    int state = numbers("arc", inputs, 2, values);
+    if (state != EVAL_STATE_COMPLETE)
+    {
+        return state;
+    }
+    turtle_arc(values[0], values[1]);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_wrap(const value_t *inputs, value_t *output)
+{
+    turtle_set_boundary(TURTLE_WRAP);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_window(const value_t *inputs, value_t *output)
+{
+    turtle_set_boundary(TURTLE_WINDOW);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_fence(const value_t *inputs, value_t *output)
+{
+    turtle_set_boundary(TURTLE_FENCE);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_norefresh(const value_t *inputs, value_t *output)
+{
+    screen_gfx_defer(true);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_refresh(const value_t *inputs, value_t *output)
+{
+    screen_gfx_defer(false);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_updategraph(const value_t *inputs, value_t *output)
+{
+    screen_gfx_present();
+    return EVAL_STATE_COMPLETE;
+}
+
+// Get the turtles named by a number or a list of numbers, one bit each.
+// Returns false if the value names no turtles or one that does not exist.
+// The VM uses this for ASK.
+bool primitive_turtles(value_t value, uint32_t *turtles)
+{
+    uint16_t node = value.type == VALUE_LIST ? value.node : HEAP_NIL;
+    *turtles = 0;
+    do
+    {
+        int32_t turtle;
+        if (!value_to_integer(node != HEAP_NIL ? heap_nodes[node].first : value, &turtle) ||
+            turtle < 0 || turtle >= TURTLE_COUNT)
+        {
+            return false;
+        }
+        *turtles |= 1u << turtle;
+        node = node != HEAP_NIL ? heap_nodes[node].rest : HEAP_NIL;
+    } while (node != HEAP_NIL);
+    return true;
+}
+
+static int prim_tell(const value_t *inputs, value_t *output)
+{
+    uint32_t turtles;
+    if (!primitive_turtles(inputs[0], &turtles))
+    {
+        return value_error("tell", inputs[0]);
+    }
+    turtle_tell(turtles);
+    return EVAL_STATE_COMPLETE;
+}
+
+// Output the turtle being told, or a list of them if there is more than one
+static int prim_who(const value_t *inputs, value_t *output)
+{
+    uint32_t turtles = turtle_get_told();
+    if (!(turtles & (turtles - 1)))
+    {
+        *output = value_integer(__builtin_ctz(turtles));
+        return EVAL_STATE_COMPLETE;
+    }
+    if (!heap_reserve(__builtin_popcount(turtles)))
+    {
+        return EVAL_STATE_ERROR;
+    }
+
+    // Build the list from the end so it comes out in order
+    uint16_t list = HEAP_NIL;
+    for (int turtle = TURTLE_COUNT - 1; turtle >= 0; turtle--)
+    {
+        if (turtles & (1u << turtle))
+        {
+            list = heap_cons(value_integer(turtle), list);
+        }
+    }
+    *output = value_list(list);
+    return EVAL_STATE_COMPLETE;
+}
+
+//
+//  Picture primitives
+//
+
+// Get the name of a picture file, which must be a word
+static int picture_filename(const char *name, value_t input)
+{
+    if (value_text(input, scratch, sizeof(scratch)) == 0)
+    {
+        return value_error(name, input);
+    }
+    return EVAL_STATE_COMPLETE;
+}
+
+// Set the error for a picture that could not be replayed, saved or loaded
+static int picture_error(int result)
+{
+    switch (result)
+    {
+    case PICTURE_OK:
+        return EVAL_STATE_COMPLETE;
+    case PICTURE_FULL:
+        return evaluate_error("Out of space for the picture");
+    case PICTURE_NO_FILE:
+        return evaluate_error("Can't open %s", scratch);
+    case PICTURE_BAD_FILE:
+        return evaluate_error("%s is not a picture", scratch);
+    default:
+        return evaluate_error("%s is from a newer version", scratch);
+    }
+}
+
+static int prim_record(const value_t *inputs, value_t *output)
+{
+    picture_record();
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_norecord(const value_t *inputs, value_t *output)
+{
+    picture_stop();
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_replay(const value_t *inputs, value_t *output)
+{
+    return picture_error(picture_replay());
+}
+
+static int prim_savepict(const value_t *inputs, value_t *output)
+{
+    int state = picture_filename("savepict", inputs[0]);
+    if (state != EVAL_STATE_COMPLETE)
+    {
+        return state;
+    }
+    return picture_error(picture_save(scratch));
+}
+
+static int prim_loadpict(const value_t *inputs, value_t *output)
+{
+    int state = picture_filename("loadpict", inputs[0]);
+    if (state != EVAL_STATE_COMPLETE)
+    {
+        return state;
+    }
+    int result = picture_load(scratch);
+    if (result == PICTURE_OK)
+    {
+        result = picture_replay();
+    }
+    return picture_error(result);
+}
+
+//
+//  Control primitives
+//
+
+static int prim_repcount(const value_t *inputs, value_t *output)
+{
+    *output = value_integer(vm_repcount());
+    return EVAL_STATE_COMPLETE;
+}
+
+//
+//  Arithmetic primitives
+//
+
+static int prim_sum(const value_t *inputs, value_t *output)
+{
+    return arithmetic("sum", OP_ADD, inputs, output);
+}
+
+static int prim_difference(const value_t *inputs, value_t *output)
+{
+    return arithmetic("difference", OP_SUBTRACT, inputs, output);
+}
+
+static int prim_product(const value_t *inputs, value_t *output)
+{
+    return arithmetic("product", OP_MULTIPLY, inputs, output);
+}
+
+static int prim_quotient(const value_t *inputs, value_t *output)
+{
+    return arithmetic("quotient", OP_DIVIDE, inputs, output);
+}
+
+static int prim_random(const value_t *inputs, value_t *output)
+{
+    int32_t range;
+    int state = integers("random", inputs, 1, &range);
+    if (state != EVAL_STATE_COMPLETE)
+    {
+        return state;
+    }
+    if (range < 1)
+    {
+        return value_error("random", inputs[0]);
+    }
+    *output = value_integer(get_rand_32() % (uint32_t)range);
+    return EVAL_STATE_COMPLETE;
+}
+
+//
+//  Predicates
+//
+
+static int prim_lessp(const value_t *inputs, value_t *output)
+{
+    return arithmetic("lessp", OP_LESS, inputs, output);
+}
+
+static int prim_greaterp(const value_t *inputs, value_t *output)
+{
+    return arithmetic("greaterp", OP_GREATER, inputs, output);
+}
+
+static int prim_equalp(const value_t *inputs, value_t *output)
+{
+    *output = value_bool(value_equal(inputs[0], inputs[1]));
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_emptyp(const value_t *inputs, value_t *output)
+{
+    value_t thing = inputs[0];
+    bool empty = thing.type == VALUE_LIST ? thing.node == HEAP_NIL : value_text(thing, scratch, sizeof(scratch)) == 0;
+    *output = value_bool(empty);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_wordp(const value_t *inputs, value_t *output)
+{
+    *output = value_bool(value_is_word(inputs[0]));
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_listp(const value_t *inputs, value_t *output)
+{
+    *output = value_bool(inputs[0].type == VALUE_LIST);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_numberp(const value_t *inputs, value_t *output)
+{
+    float number;
+    *output = value_bool(value_to_number(inputs[0], &number));
+    return EVAL_STATE_COMPLETE;
+}
+
+//
+//  Word and list primitives
+//
+
+static int prim_first(const value_t *inputs, value_t *output)
+{
+    value_t thing = inputs[0];
+    if (thing.type == VALUE_LIST)
+    {
+        if (thing.node == HEAP_NIL)
+        {
+            return value_error("first", thing);
+        }
+        *output = heap_nodes[thing.node].first;
+        return EVAL_STATE_COMPLETE;
+    }
+    if (value_text(thing, scratch, sizeof(scratch)) == 0)
+    {
+        return value_error("first", thing);
+    }
+    return output_word(scratch, 1, output);
+}
+
+static int prim_butfirst(const value_t *inputs, value_t *output)
+{
+    value_t thing = inputs[0];
+    if (thing.type == VALUE_LIST)
+    {
+        if (thing.node == HEAP_NIL)
+        {
+            return value_error("butfirst", thing);
+        }
+        *output = value_list(heap_nodes[thing.node].rest);
+        return EVAL_STATE_COMPLETE;
+    }
+    uint16_t length = value_text(thing, scratch, sizeof(scratch));
+    if (length == 0)
+    {
+        return value_error("butfirst", thing);
+    }
+    return output_word(scratch + 1, length - 1, output);
+}
+
+static int prim_last(const value_t *inputs, value_t *output)
+{
+    value_t thing = inputs[0];
+    if (thing.type == VALUE_LIST)
+    {
+        if (thing.node == HEAP_NIL)
+        {
+            return value_error("last", thing);
+        }
+        uint16_t node = thing.node;
+        while (heap_nodes[node].rest != HEAP_NIL)
+        {
+            node = heap_nodes[node].rest;
+        }
+        *output = heap_nodes[node].first;
+        return EVAL_STATE_COMPLETE;
+    }
+    uint16_t length = value_text(thing, scratch, sizeof(scratch));
+    if (length == 0)
+    {
+        return value_error("last", thing);
+    }
+    return output_word(scratch + length - 1, 1, output);
+}
+
+static int prim_butlast(const value_t *inputs, value_t *output)
+{
+    value_t thing = inputs[0];
+    if (thing.type == VALUE_LIST)
+    {
+        uint16_t length = list_length(thing);
+        if (length == 0)
+        {
+            return value_error("butlast", thing);
+        }
+        if (!heap_reserve(length - 1))
+        {
+            return EVAL_STATE_ERROR;
+        }
+        *output = value_list(list_copy(thing, length - 1, HEAP_NIL));
+        return EVAL_STATE_COMPLETE;
+    }
+    uint16_t length = value_text(thing, scratch, sizeof(scratch));
+    if (length == 0)
+    {
+        return value_error("butlast", thing);
+    }
+    return output_word(scratch, length - 1, output);
+}
+
+static int prim_fput(const value_t *inputs, value_t *output)
+{
+    if (inputs[1].type != VALUE_LIST)
+    {
+        return value_error("fput", inputs[1]);
+    }
+    if (!heap_reserve(1))
+    {
+        return EVAL_STATE_ERROR;
+    }
+    *output = value_list(heap_cons(inputs[0], inputs[1].node));
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_lput(const value_t *inputs, value_t *output)
+{
+    if (inputs[1].type != VALUE_LIST)
+    {
+        return value_error("lput", inputs[1]);
+    }
+    uint16_t length = list_length(inputs[1]);
+    if (!heap_reserve(length + 1))
+    {
+        return EVAL_STATE_ERROR;
+    }
+    *output = value_list(list_copy(inputs[1], length, heap_cons(inputs[0], HEAP_NIL)));
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_list(const value_t *inputs, value_t *output)
+{
+    if (!heap_reserve(2))
+    {
+        return EVAL_STATE_ERROR;
+    }
+    *output = value_list(heap_cons(inputs[0], heap_cons(inputs[1], HEAP_NIL)));
+    return EVAL_STATE_COMPLETE;
+}
+
+// Join two things into one list; the elements of a list input are used
+// rather than the list itself
+static int prim_sentence(const value_t *inputs, value_t *output)
+{
+    value_t a = inputs[0];
+    value_t b = inputs[1];
+    uint16_t length = a.type == VALUE_LIST ? list_length(a) : 1;
+    if (!heap_reserve(length + 1))
+    {
+        return EVAL_STATE_ERROR;
+    }
+
+    // The second list is shared rather than copied
+    uint16_t rest = b.type == VALUE_LIST ? b.node : heap_cons(b, HEAP_NIL);
+    *output = value_list(a.type == VALUE_LIST ? list_copy(a, length, rest) : heap_cons(a, rest));
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_word(const value_t *inputs, value_t *output)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        if (!value_is_word(inputs[i]))
+        {
+            return value_error("word", inputs[i]);
+        }
+    }
+    uint16_t length = value_text(inputs[0], scratch, sizeof(scratch));
+    length += value_text(inputs[1], scratch + length, sizeof(scratch) - length);
+    if (length == HEAP_WORD_MAX)
+    {
+        return evaluate_error("Word too long");
+    }
+    return output_word(scratch, length, output);
+}
+
+static int prim_count(const value_t *inputs, value_t *output)
+{
+    value_t thing = inputs[0];
+    uint16_t count = thing.type == VALUE_LIST ? list_length(thing) : value_text(thing, scratch, sizeof(scratch));
+    *output = value_integer(count);
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_item(const value_t *inputs, value_t *output)
+{
+    int32_t index;
+    int state = integers("item", inputs, 1, &index);
+    if (state != EVAL_STATE_COMPLETE)
+    {
+        return state;
+    }
+
+    value_t thing = inputs[1];
+    if (thing.type == VALUE_LIST)
+    {
+        uint16_t node = thing.node;
+        for (int32_t i = 1; i < index && node != HEAP_NIL; i++)
+        {
+            node = heap_nodes[node].rest;
+        }
+        if (index < 1 || node == HEAP_NIL)
+        {
+            return value_error("item", inputs[0]);
+        }
+        *output = heap_nodes[node].first;
+        return EVAL_STATE_COMPLETE;
+    }
+    uint16_t length = value_text(thing, scratch, sizeof(scratch));
+    if (index < 1 || index > length)
+    {
+        return value_error("item", inputs[0]);
+    }
+    return output_word(scratch + index - 1, 1, output);
+}
+
+//
+//  Variable primitives
+//
+
+static int prim_make(const value_t *inputs, value_t *output)
+{
+    uint16_t length = value_text(inputs[0], scratch, sizeof(scratch));
+    if (length == 0)
+    {
+        return value_error("make", inputs[0]);
+    }
+    symbol_t *symbol = symbol_intern(scratch, length);
+    if (!symbol)
+    {
+        return evaluate_error("Out of space for words");
+    }
+    symbol->bound = true;
+    symbol->value = inputs[1];
+    return EVAL_STATE_COMPLETE;
+}
+
+//
+//  Input/output primitives
+//
+
+static int prim_print(const value_t *inputs, value_t *output)
+{
+    value_print(inputs[0], false);
+    printf("\n");
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_show(const value_t *inputs, value_t *output)
+{
+    value_print(inputs[0], true);
+    printf("\n");
+    return EVAL_STATE_COMPLETE;
+}
+
+//
+//  System primitives
+//
+
+static int prim_version(const value_t *inputs, value_t *output)
+{
+    print_version();
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_license(const value_t *inputs, value_t *output)
+{
+    print_license();
+    return EVAL_STATE_COMPLETE;
+}
+
+// Report the size of the symbol table
+static int prim_symbols(const value_t *inputs, value_t *output)
+{
+    uint16_t entries;
+    uint32_t bytes;
+    symbols_stats(&entries, &bytes);
+    printf("%u of %u words, %lu bytes\n", entries, SYMBOL_COUNT, (unsigned long)bytes);
+    return EVAL_STATE_COMPLETE;
+}
+
+// Output the nodes in use and the most in use since NODES was last called
+static int prim_nodes(const value_t *inputs, value_t *output)
+{
+    if (!heap_reserve(2))
+    {
+        return EVAL_STATE_ERROR;
+    }
+    uint16_t used, peak;
+    heap_stats(&used, &peak);
+    *output = value_list(heap_cons(value_integer(used), heap_cons(value_integer(peak), HEAP_NIL)));
+    return EVAL_STATE_COMPLETE;
+}
+
+// Output the updates that sent anything to the LCD, and the blits they
+// took, since .BLITS was last called
+static int prim_blits(const value_t *inputs, value_t *output)
+{
+    if (!heap_reserve(2))
+    {
+        return EVAL_STATE_ERROR;
+    }
+    uint32_t frames, blits;
+    screen_gfx_stats(&frames, &blits);
+    *output = value_list(heap_cons(value_integer(frames), heap_cons(value_integer(blits), HEAP_NIL)));
+    return EVAL_STATE_COMPLETE;
+}
+
+static int prim_recycle(const value_t *inputs, value_t *output)
+{
+    heap_collect();
+    return EVAL_STATE_COMPLETE;
+}
+
+//
+//  Primitive table
+//
+
+#define PRIMITIVE(id, name, inputs, outputs, handler) {name, inputs, outputs, handler},
+#define ALIAS(id, name)
+const primitive_t primitives[PRIMITIVE_COUNT] = {
+#include "primitives.def"
+};
+#undef PRIMITIVE
+#undef ALIAS
+
+// Find a primitive by name (case insensitive), returning its index or -1.
+// The hash tables are generated from primitives.def by primitives.cmake,
+// which computes the same hash, so this is a single probe.
+int primitive_find(const char *name, uint16_t length)
+{
+    uint32_t hash = PRIMITIVE_HASH_BASIS;
+    for (uint16_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ (uint8_t)tolower((unsigned char)name[i])) * PRIMITIVE_HASH_PRIME;
+    }
+
+    uint32_t displacement = primitive_hash_displacements[hash & (PRIMITIVE_HASH_BUCKETS - 1)];
+    uint32_t slot = (((hash ^ displacement) * PRIMITIVE_HASH_PRIME) >> 16) & (PRIMITIVE_HASH_SLOTS - 1);
+
+    const char *candidate = primitive_hash_slots[slot].name;
+    if (candidate && strncasecmp(candidate, name, length) == 0 && candidate[length] == '\0')
+    {
+        return primitive_hash_slots[slot].index;
+    }
+    return -1;
+}
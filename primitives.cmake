@@ -0,0 +1,204 @@
+#
+#  PicoCalc Logo
+#  Copyright Blair Leduc.
+#  See LICENSE for details.
+#
+
+#
+#  Generate a perfect hash of primitive names
+#
+#  Run as a script: cmake -DINPUT=primitives.def -DOUTPUT=primitives_hash.h -P primitives.cmake
+#
+#  Every name and alias in INPUT is hashed with 32-bit FNV-1a. The low bits
+#  of the hash pick a bucket, and each bucket has a displacement chosen here
+#  so that re-mixing the hash with it sends every name to its own slot.
+#  A lookup is therefore one hash, one displacement and one compare, no
+#  matter how many primitives there are. primitive_find() in primitives.c
+#  must compute exactly the same function.
+#
+
+cmake_minimum_required(VERSION 3.13)
+
+set(FNV_BASIS 2166136261)
+set(FNV_PRIME 16777619)
+
+# Printable ASCII, so a character's code is its position plus 32
+set(ascii "")
+foreach(code RANGE 32 126)
+    string(ASCII ${code} char)
+    string(APPEND ascii "${char}")
+endforeach()
+
+# FNV-1a hash of a (lower case) name
+function(fnv_hash name result)
+    set(hash ${FNV_BASIS})
+    string(LENGTH "${name}" length)
+    math(EXPR last "${length} - 1")
+    foreach(i RANGE ${last})
+        string(SUBSTRING "${name}" ${i} 1 char)
+        string(FIND "${ascii}" "${char}" code)
+        math(EXPR hash "((${hash} ^ (${code} + 32)) * ${FNV_PRIME}) & 0xFFFFFFFF")
+    endforeach()
+    set(${result} ${hash} PARENT_SCOPE)
+endfunction()
+
+# Slot for a hash and a displacement
+function(slot_of hash displacement result)
+    math(EXPR slot "((((${hash} ^ ${displacement}) * ${FNV_PRIME}) & 0xFFFFFFFF) >> 16) & (${slots} - 1)")
+    set(${result} ${slot} PARENT_SCOPE)
+endfunction()
+
+#
+#  Read the primitive table
+#
+
+file(STRINGS "${INPUT}" lines REGEX "^(PRIMITIVE|ALIAS)\\(")
+
+set(ids "")
+set(names "")
+set(indexes "")
+foreach(line IN LISTS lines)
+    if(line MATCHES "^PRIMITIVE\\(([A-Z0-9_]+), *\"([^\"]+)\"")
+        list(LENGTH ids index)
+        list(APPEND ids ${CMAKE_MATCH_1})
+        list(APPEND names "${CMAKE_MATCH_2}")
+        list(APPEND indexes ${index})
+    elseif(line MATCHES "^ALIAS\\(([A-Z0-9_]+), *\"([^\"]+)\"")
+        list(FIND ids ${CMAKE_MATCH_1} index)
+        if(index EQUAL -1)
+            message(FATAL_ERROR "Alias ${CMAKE_MATCH_2} refers to unknown primitive ${CMAKE_MATCH_1}")
+        endif()
+        list(APPEND names "${CMAKE_MATCH_2}")
+        list(APPEND indexes ${index})
+    endif()
+endforeach()
+
+list(LENGTH ids primitive_count)
+list(LENGTH names name_count)
+if(primitive_count GREATER 255)
+    message(FATAL_ERROR "Too many primitives (${primitive_count}), bytecode operands are 8 bits")
+endif()
+
+# At most half the slots are used, and about two names share a bucket
+math(EXPR target "${name_count} * 2")
+set(slots 16)
+while(slots LESS target)
+    math(EXPR slots "${slots} * 2")
+endwhile()
+math(EXPR buckets "${slots} / 4")
+
+#
+#  Hash every name into its bucket
+#
+
+math(EXPR last_name "${name_count} - 1")
+math(EXPR last_bucket "${buckets} - 1")
+math(EXPR last_slot "${slots} - 1")
+
+foreach(bucket RANGE ${last_bucket})
+    set(bucket_${bucket} "")
+endforeach()
+
+foreach(i RANGE ${last_name})
+    list(GET names ${i} name)
+    string(TOLOWER "${name}" lower)
+    if(NOT lower STREQUAL name)
+        message(FATAL_ERROR "Primitive name ${name} must be lower case")
+    endif()
+    if(DEFINED seen_${name})
+        message(FATAL_ERROR "Primitive name ${name} is defined twice")
+    endif()
+    set(seen_${name} TRUE)
+    fnv_hash("${name}" hash)
+    set(hash_${i} ${hash})
+    math(EXPR bucket "${hash} & (${buckets} - 1)")
+    list(APPEND bucket_${bucket} ${i})
+endforeach()
+
+#
+#  Place the largest buckets first, searching for a displacement that puts
+#  every name in the bucket into a free slot
+#
+
+foreach(slot RANGE ${last_slot})
+    set(slot_${slot} -1)
+endforeach()
+foreach(bucket RANGE ${last_bucket})
+    set(displacement_${bucket} 0)
+endforeach()
+
+foreach(size RANGE ${name_count} 1 -1)
+    foreach(bucket RANGE ${last_bucket})
+        list(LENGTH bucket_${bucket} bucket_size)
+        if(NOT bucket_size EQUAL size)
+            continue()
+        endif()
+
+        set(displacement 0)
+        while(TRUE)
+            set(placed "")
+            set(ok TRUE)
+            foreach(i IN LISTS bucket_${bucket})
+                slot_of(${hash_${i}} ${displacement} slot)
+                list(FIND placed ${slot} taken)
+                if(NOT slot_${slot} EQUAL -1 OR NOT taken EQUAL -1)
+                    set(ok FALSE)
+                    break()
+                endif()
+                list(APPEND placed ${slot})
+            endforeach()
+            if(ok)
+                break()
+            endif()
+            math(EXPR displacement "${displacement} + 1")
+            if(displacement GREATER 65535)
+                message(FATAL_ERROR "No perfect hash found for bucket ${bucket}")
+            endif()
+        endwhile()
+
+        set(displacement_${bucket} ${displacement})
+        foreach(i IN LISTS bucket_${bucket})
+            slot_of(${hash_${i}} ${displacement} slot)
+            set(slot_${slot} ${i})
+        endforeach()
+    endforeach()
+endforeach()
+
+#
+#  Write the header
+#
+
+set(text "//\n//  Generated by primitives.cmake from primitives.def, do not edit.\n//\n\n#pragma once\n\n")
+string(APPEND text "#include \"pico/stdlib.h\"\n\n")
+string(APPEND text "#define PRIMITIVE_HASH_BASIS (${FNV_BASIS}u) // FNV-1a offset basis\n")
+string(APPEND text "#define PRIMITIVE_HASH_PRIME (${FNV_PRIME}u)   // FNV-1a prime\n")
+string(APPEND text "#define PRIMITIVE_HASH_BUCKETS (${buckets}) // Number of displacement buckets\n")
+string(APPEND text "#define PRIMITIVE_HASH_SLOTS (${slots})   // Number of slots in the table\n\n")
+
+string(APPEND text "static const uint16_t primitive_hash_displacements[PRIMITIVE_HASH_BUCKETS] = {\n")
+foreach(bucket RANGE ${last_bucket})
+    string(APPEND text "    ${displacement_${bucket}},\n")
+endforeach()
+string(APPEND text "};\n\n")
+
+string(APPEND text "static const struct\n{\n    const char *name; // Name or alias, NULL if the slot is empty\n    uint8_t index;    // Index into primitives[]\n} primitive_hash_slots[PRIMITIVE_HASH_SLOTS] = {\n")
+foreach(slot RANGE ${last_slot})
+    set(i ${slot_${slot}})
+    if(i EQUAL -1)
+        string(APPEND text "    {NULL, 0},\n")
+    else()
+        list(GET names ${i} name)
+        list(GET indexes ${i} index)
+        string(APPEND text "    {\"${name}\", ${index}},\n")
+    endif()
+endforeach()
+string(APPEND text "};\n")
+
+# Only touch the output if it changed, to avoid needless rebuilds
+if(EXISTS "${OUTPUT}")
+    file(READ "${OUTPUT}" previous)
+    if(previous STREQUAL text)
+        return()
+    endif()
+endif()
+file(WRITE "${OUTPUT}" "${text}")
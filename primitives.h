@@ -0,0 +1,41 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#include "vm.h"
+
+// Primitive indexes, in the order of primitives.def
+#define PRIMITIVE(id, name, inputs, outputs, handler) PRIM_##id,
+#define ALIAS(id, name)
+enum
+{
+#include "primitives.def"
+    PRIMITIVE_COUNT
+};
+#undef PRIMITIVE
+#undef ALIAS
+
+// A primitive takes its inputs in order and sets *output if it outputs a value.
+// Returns EVAL_STATE_COMPLETE or EVAL_STATE_ERROR.
+typedef int (*primitive_handler_t)(const value_t *inputs, value_t *output);
+
+// A built-in procedure
+typedef struct
+{
+    const char *name;            // Full name, e.g. forward
+    uint8_t inputs;              // Number of inputs
+    bool outputs;                // True if the primitive outputs a value
+    primitive_handler_t handler; // Implementation, NULL for special forms
+} primitive_t;
+
+extern const primitive_t primitives[PRIMITIVE_COUNT];
+
+// Function prototypes
+int primitive_find(const char *name, uint16_t length);
+bool primitive_turtles(value_t value, uint32_t *turtles);
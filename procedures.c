@@ -0,0 +1,301 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+//
+//  User procedures
+//
+//  A procedure is compiled to bytecode once, when END is typed, and the
+//  VM runs that code on every call. The source text is kept so the body
+//  can be compiled again if needed.
+//
+//  Calls are compiled using the number of inputs of the procedure being
+//  called, so a body can only be compiled once everything it calls exists.
+//  A body that calls a procedure not yet defined is left uncompiled, and is
+//  compiled when another procedure is defined or on its first call instead.
+//  Any other error in the body is reported at END, and the procedure is not
+//  defined.
+//
+//  Whether a procedure outputs is first guessed from whether the word
+//  OUTPUT appears in its body, but it may only be in a list given as data.
+//  The compiler knows which OUTPUTs are instructions, so the body is
+//  compiled again the other way round when that disagrees with the guess,
+//  or when it only compiles the other way round. Calls the body makes to
+//  the procedure itself are checked against the answer.
+//
+//  If a procedure is redefined with a different number of inputs, or stops
+//  or starts outputting, every body compiled against the old definition is
+//  out of date: procedure_epoch is advanced and each body is compiled again
+//  the next time it is called. Redefining a procedure without changing its
+//  inputs only recompiles that procedure, as callers refer to it by index.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "compiler.h"
+#include "evaluate.h"
+#include "lexer.h"
+#include "primitives.h"
+#include "procedures.h"
+#include "symbols.h"
+
+procedure_t procedures[PROCEDURE_COUNT]; // The procedures, indexed by symbol->procedure
+static uint16_t procedure_count = 0;     // Number of procedures defined
+static uint16_t procedure_epoch = 0;     // Advanced when calls to a procedure must be recompiled
+
+// The procedure being defined
+static procedure_t pending;                        // Name and inputs from the TO line
+static char pending_source[PROCEDURE_SOURCE_SIZE]; // Body lines typed so far
+static uint16_t pending_length = 0;                // Length of the body so far
+
+static uint8_t scratch[PROCEDURE_CODE_SIZE]; // Compiler output before it is copied
+
+//
+//  Helper functions
+//
+
+// Check if the body contains the word OUTPUT anywhere, the first guess at
+// whether the procedure is an operation
+static bool body_outputs(const char *source)
+{
+    lexer_t lexer;
+    lexer_init(&lexer, source);
+    while (lexer_peek(&lexer)->type != TOKEN_END)
+    {
+        token_t token = lexer_next(&lexer);
+        if (token.type == TOKEN_WORD && primitive_find(token.text, token.length) == PRIM_OUTPUT)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Compile the body of a procedure into memory of its own, settling whether
+// it outputs. Sets *undefined if it could not be compiled because it calls
+// a procedure that is not defined yet.
+static int compile_body(procedure_t *procedure, bool *undefined)
+{
+    code_t code;
+    bool compiled = false;
+    *undefined = false;
+    for (int attempt = 0; attempt < 2 && !compiled; attempt++)
+    {
+        code = (code_t){scratch, 0, sizeof(scratch)};
+        int state = compile(&code, procedure->source, procedure);
+        *undefined |= code.undefined;
+        compiled = state == EVAL_STATE_COMPLETE && code.outputs == procedure->outputs;
+        if (!compiled)
+        {
+            procedure->outputs = !procedure->outputs;
+        }
+    }
+    if (!compiled)
+    {
+        return EVAL_STATE_ERROR; // Neither way round: the error is already set
+    }
+
+    uint8_t *bytes = malloc(code.length);
+    if (!bytes)
+    {
+        return evaluate_error("Out of memory compiling %s", symbol_get(procedure->name)->name);
+    }
+    memcpy(bytes, scratch, code.length);
+
+    free(procedure->code.bytes);
+    procedure->code = code;
+    procedure->code.bytes = bytes;
+    procedure->code.capacity = code.length;
+    procedure->epoch = procedure_epoch;
+
+    return EVAL_STATE_COMPLETE;
+}
+
+//
+//  Procedure functions
+//
+
+// Start defining a procedure from a line such as: to square :size
+int procedure_begin(const char *header)
+{
+    lexer_t lexer;
+    lexer_init(&lexer, header);
+    lexer_next(&lexer); // Skip TO
+
+    token_t token = lexer_next(&lexer);
+    if (token.type != TOKEN_WORD)
+    {
+        return evaluate_error("to doesn't like %.*s as input", token.length, token.text);
+    }
+    symbol_t *symbol = symbol_intern(token.text, token.length);
+    if (!symbol)
+    {
+        return evaluate_error("Out of space for words");
+    }
+    if (symbol->primitive >= 0)
+    {
+        return evaluate_error("%s is a primitive", symbol->name);
+    }
+
+    memset(&pending, 0, sizeof(pending));
+    pending.name = symbol_id(symbol);
+
+    while (lexer_peek(&lexer)->type != TOKEN_END)
+    {
+        token = lexer_next(&lexer);
+        if (token.type != TOKEN_VARIABLE)
+        {
+            return evaluate_error("to doesn't like %.*s as input", token.length, token.text);
+        }
+        if (pending.inputs == PROCEDURE_INPUTS)
+        {
+            return evaluate_error("Too many inputs to %s", symbol->name);
+        }
+        symbol_t *param = symbol_intern(token.text, token.length);
+        if (!param)
+        {
+            return evaluate_error("Out of space for words");
+        }
+        pending.params[pending.inputs++] = symbol_id(param);
+    }
+
+    pending_length = 0;
+    pending_source[0] = '\0';
+    return EVAL_STATE_COMPLETE;
+}
+
+// Add a line to the body of the procedure being defined
+int procedure_add_line(const char *line)
+{
+    size_t length = strlen(line);
+    if (pending_length + length + 2 > sizeof(pending_source))
+    {
+        return evaluate_error("%s is too long", symbol_get(pending.name)->name);
+    }
+    memcpy(pending_source + pending_length, line, length);
+    pending_length += length;
+    pending_source[pending_length++] = '\n';
+    pending_source[pending_length] = '\0';
+    return EVAL_STATE_COMPLETE;
+}
+
+// Finish defining the procedure and compile it
+int procedure_end(void)
+{
+    symbol_t *symbol = symbol_get(pending.name);
+
+    char *source = malloc(pending_length + 1);
+    if (!source)
+    {
+        return evaluate_error("Out of memory defining %s", symbol->name);
+    }
+    memcpy(source, pending_source, pending_length + 1);
+    pending.outputs = body_outputs(source);
+
+    // A redefinition keeps the index so existing calls still refer to it,
+    // and the old definition until the new one has compiled
+    procedure_t old = {0};
+    bool redefined = symbol->procedure >= 0;
+    procedure_t *procedure;
+    if (redefined)
+    {
+        procedure = &procedures[symbol->procedure];
+        old = *procedure;
+    }
+    else
+    {
+        if (procedure_count == PROCEDURE_COUNT)
+        {
+            free(source);
+            return evaluate_error("Too many procedures");
+        }
+        symbol->procedure = procedure_count;
+        procedure = &procedures[procedure_count++];
+    }
+
+    *procedure = pending;
+    procedure->source = source;
+    procedure->code.bytes = NULL;
+
+    // Compile now so calls run at full speed. A body that refers to a
+    // procedure that is not defined yet is compiled later; any other error
+    // leaves the procedure as it was.
+    bool undefined;
+    if (compile_body(procedure, &undefined) != EVAL_STATE_COMPLETE && !undefined)
+    {
+        free(source);
+        if (redefined)
+        {
+            *procedure = old;
+        }
+        else
+        {
+            symbol->procedure = -1;
+            procedure_count--;
+        }
+        return EVAL_STATE_ERROR;
+    }
+
+    if (redefined)
+    {
+        if (old.inputs != procedure->inputs || old.outputs != procedure->outputs)
+        {
+            procedure_epoch++;
+            procedure->epoch = procedure_epoch;
+        }
+        free(old.source);
+        free(old.code.bytes);
+    }
+
+    // Bodies waiting for this procedure can be compiled now, which settles
+    // whether they output before anything calls them. One that still cannot
+    // be compiled waits for its first call.
+    for (uint16_t i = 0; i < procedure_count; i++)
+    {
+        procedure_t *waiting = &procedures[i];
+        bool outputs = waiting->outputs;
+        if (!waiting->code.bytes && compile_body(waiting, &undefined) == EVAL_STATE_COMPLETE &&
+            waiting->outputs != outputs)
+        {
+            procedure_epoch++;
+            waiting->epoch = procedure_epoch;
+        }
+    }
+
+    printf("%s defined\n", symbol->name);
+    return EVAL_STATE_COMPLETE;
+}
+
+// Make sure the procedure is compiled against the current definitions
+int procedure_prepare(procedure_t *procedure)
+{
+    if (procedure->code.bytes && procedure->epoch == procedure_epoch)
+    {
+        return EVAL_STATE_COMPLETE;
+    }
+
+    bool outputs = procedure->outputs;
+    bool undefined;
+    int state = compile_body(procedure, &undefined);
+    if (state != EVAL_STATE_COMPLETE || procedure->outputs == outputs)
+    {
+        return state;
+    }
+
+    // The call was compiled for the guess, which was wrong: recompile the
+    // callers and give the error they would have had
+    procedure_epoch++;
+    procedure->epoch = procedure_epoch;
+    const char *name = symbol_get(procedure->name)->name;
+    if (procedure->outputs)
+    {
+        return evaluate_error("You don't say what to do with %s", name);
+    }
+    return evaluate_error("%s didn't output", name);
+}
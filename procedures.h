@@ -0,0 +1,37 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#include "bytecode.h"
+
+// Procedure limits
+#define PROCEDURE_COUNT (128)        // Maximum number of user procedures
+#define PROCEDURE_INPUTS (8)         // Maximum number of inputs to a procedure
+#define PROCEDURE_SOURCE_SIZE (4096) // Longest procedure body in bytes
+#define PROCEDURE_CODE_SIZE (4096)   // Longest compiled procedure body in bytes
+
+// A user procedure defined with TO ... END
+typedef struct
+{
+    uint16_t name;                     // Symbol id of the name
+    uint8_t inputs;                    // Number of inputs
+    bool outputs;                      // True if the body uses OUTPUT
+    uint16_t params[PROCEDURE_INPUTS]; // Symbol ids of the inputs, in order
+    char *source;                      // Text of the body
+    code_t code;                       // Compiled body, bytes is NULL until compiled
+    uint16_t epoch;                    // Value of procedure_epoch when compiled
+} procedure_t;
+
+extern procedure_t procedures[PROCEDURE_COUNT];
+
+// Function prototypes
+int procedure_begin(const char *header);
+int procedure_add_line(const char *line);
+int procedure_end(void);
+int procedure_prepare(procedure_t *procedure);
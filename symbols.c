@@ -0,0 +1,151 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+//
+//  Symbol table
+//
+//  Words are interned when they are compiled: the text is copied once into
+//  a fixed arena and the word is known by its symbol from then on. Procedure
+//  and variable names are compared by symbol id, never by text. Nothing is
+//  ever freed; like other Logos, a word once seen stays in the table.
+//
+//  A symbol also holds the value of the variable with its name. Procedure
+//  inputs are bound by saving the old value and storing the new one in the
+//  symbol (shallow binding), so reading a variable is a single load.
+//
+//  The words true and false are always the first two symbols, so a truth
+//  value is tested by comparing ids.
+//
+//  The table is statically sized (see SYMBOL_COUNT and SYMBOL_ARENA_SIZE)
+//  so it shows up in the memory map next to the frame buffers.
+//
+
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+#include "pico/stdlib.h"
+
+#include "primitives.h"
+#include "symbols.h"
+
+_Static_assert((SYMBOL_BUCKETS & (SYMBOL_BUCKETS - 1)) == 0, "SYMBOL_COUNT must be a power of two");
+_Static_assert(SYMBOL_COUNT < SYMBOL_NONE, "SYMBOL_COUNT must fit in a 16-bit id");
+
+symbol_t symbol_table[SYMBOL_COUNT];     // The symbols, indexed by id
+static uint16_t symbol_count = 0;        // Number of symbols in use
+static uint16_t buckets[SYMBOL_BUCKETS]; // First symbol id + 1 in each bucket, 0 if empty
+static char arena[SYMBOL_ARENA_SIZE];    // Text of all symbol names
+static uint32_t arena_used = 0;          // Bytes of the arena in use
+
+//
+//  Helper functions
+//
+
+// Case-folded FNV-1a hash of a name
+static uint32_t hash_name(const char *name, uint16_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (uint16_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ (uint8_t)tolower((unsigned char)name[i])) * 16777619u;
+    }
+    return hash;
+}
+
+// Find a symbol given the hash of its name
+static symbol_t *find(const char *name, uint16_t length, uint32_t hash)
+{
+    uint16_t id = buckets[hash & (SYMBOL_BUCKETS - 1)];
+    for (id = id ? id - 1 : SYMBOL_NONE; id != SYMBOL_NONE; id = symbol_table[id].next)
+    {
+        symbol_t *symbol = &symbol_table[id];
+        if (symbol->hash == hash && symbol->length == length &&
+            strncasecmp(symbol->name, name, length) == 0)
+        {
+            return symbol;
+        }
+    }
+    return NULL;
+}
+
+// Add a symbol that is not in the table
+static symbol_t *add(const char *name, uint16_t length, uint32_t hash)
+{
+    if (symbol_count == SYMBOL_COUNT || arena_used + length + 1 > SYMBOL_ARENA_SIZE)
+    {
+        return NULL;
+    }
+
+    // Copy the name into the arena
+    char *text = arena + arena_used;
+    memcpy(text, name, length);
+    text[length] = '\0';
+    arena_used += length + 1;
+
+    // Link the new symbol at the head of its bucket
+    uint16_t id = symbol_count++;
+    uint16_t *bucket = &buckets[hash & (SYMBOL_BUCKETS - 1)];
+    symbol_t *symbol = &symbol_table[id];
+    symbol->name = text;
+    symbol->length = length;
+    symbol->hash = hash;
+    symbol->next = *bucket ? *bucket - 1 : SYMBOL_NONE;
+    symbol->primitive = (int16_t)primitive_find(name, length);
+    symbol->procedure = -1;
+    symbol->bound = false;
+    *bucket = id + 1;
+
+    return symbol;
+}
+
+// Intern the words every program needs before anything else
+static void add_reserved(void)
+{
+    add("true", 4, hash_name("true", 4));
+    add("false", 5, hash_name("false", 5));
+}
+
+//
+//  Symbol functions
+//
+
+// Get the symbol for a word, adding it to the table if it is new.
+// Returns NULL if the table or the arena is full.
+symbol_t *symbol_intern(const char *name, uint16_t length)
+{
+    if (symbol_count == 0)
+    {
+        add_reserved();
+    }
+
+    uint32_t hash = hash_name(name, length);
+    symbol_t *symbol = find(name, length, hash);
+    if (symbol)
+    {
+        return symbol;
+    }
+    return add(name, length, hash);
+}
+
+// Get the symbol for a word without adding it, or NULL if it is not interned
+symbol_t *symbol_lookup(const char *name, uint16_t length)
+{
+    return find(name, length, hash_name(name, length));
+}
+
+// Report how much of the symbol table is in use
+void symbols_stats(uint16_t *entries, uint32_t *bytes)
+{
+    if (entries)
+    {
+        *entries = symbol_count;
+    }
+    if (bytes)
+    {
+        *bytes = arena_used + symbol_count * sizeof(symbol_t);
+    }
+}
@@ -0,0 +1,56 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#include "heap.h"
+
+// Symbol table limits, override from CMake to size them for the board
+#ifndef SYMBOL_COUNT
+#define SYMBOL_COUNT (1024) // Maximum number of distinct words
+#endif
+#ifndef SYMBOL_ARENA_SIZE
+#define SYMBOL_ARENA_SIZE (8192) // Bytes available for the text of words
+#endif
+#define SYMBOL_BUCKETS (SYMBOL_COUNT / 2) // Hash buckets, a power of two
+#define SYMBOL_NONE (0xFFFF)              // Id meaning no symbol
+#define SYMBOL_TRUE (0)                   // Id of the word true, interned first
+#define SYMBOL_FALSE (1)                  // Id of the word false, interned second
+
+// An interned word. Each distinct word (ignoring case) is stored once, so
+// two words are equal exactly when their symbols are the same.
+typedef struct
+{
+    const char *name;  // The word as first seen, NUL terminated, in the arena
+    uint16_t length;   // Length of the name
+    uint16_t next;     // Next symbol id in the same hash bucket, or SYMBOL_NONE
+    uint32_t hash;     // Case-folded hash of the name
+    int16_t primitive; // Index of the primitive with this name, or -1
+    int16_t procedure; // Index of the procedure with this name, or -1
+    bool bound;        // True if the word has a value as a variable
+    value_t value;     // Value of the variable (shallow binding)
+} symbol_t;
+
+extern symbol_t symbol_table[SYMBOL_COUNT];
+
+// Get the symbol with the given id
+static inline symbol_t *symbol_get(uint16_t id)
+{
+    return &symbol_table[id];
+}
+
+// Get the id of a symbol
+static inline uint16_t symbol_id(const symbol_t *symbol)
+{
+    return (uint16_t)(symbol - symbol_table);
+}
+
+// Function prototypes
+symbol_t *symbol_intern(const char *name, uint16_t length);
+symbol_t *symbol_lookup(const char *name, uint16_t length);
+void symbols_stats(uint16_t *entries, uint32_t *bytes);
@@ -4,200 +4,587 @@
 //  See LICENSE for details.
 //
 
+//
+//  Turtles
+//
+//  There are TURTLE_COUNT turtles, each with its own position, heading,
+//  pen and visibility, kept as one array per field. Commands go to the
+//  turtles last named by TELL, held as a bit mask, and each command runs
+//  for all of them before the next one starts. Their lines are queued for
+//  core 1 one after another and their sprites only change in core 0's copy,
+//  so however many turtles move, the screen is updated once, at the next
+//  refresh. Questions such as HEADING are answered by the first of them.
+//
+//  ASK saves the turtles being told on a small stack and restores them when
+//  its instructions finish, or when a STOP, OUTPUT or error leaves them.
+//
+//  Turtle 0 is shown from the start. The others stay hidden at home until
+//  they are first told something. One polygon is filled at a time, by the
+//  first turtle told when BEGINFILL is used.
+//
+
 #include <math.h>
 
+#include "picture.h"
 #include "turtle.h"
 
-// Turtle state
-float turtle_x = TURTLE_HOME_X;                  // Current x position for graphics
-float turtle_y = TURTLE_HOME_Y;                  // Current y position for graphics
-float turtle_angle = TURTLE_DEFAULT_ANGLE;       // Current angle for graphics
-uint16_t turtle_colour = TURTLE_DEFAULT_COLOUR;    // Turtle color for graphics
-static bool turtle_pen_down = TURTLE_DEFAULT_PEN_DOWN;  // Pen state for graphics
-static bool turtle_visible = TURTLE_DEFAULT_VISIBILITY; // Turtle visibility state for graphics
-
+_Static_assert(TURTLE_COUNT <= 32, "TURTLE_COUNT must fit in a 32-bit mask");
+
+// Turtle state, one entry for each turtle
+static float turtle_x[TURTLE_COUNT] = {[0 ... TURTLE_COUNT - 1] = TURTLE_HOME_X};                // Position across
+static float turtle_y[TURTLE_COUNT] = {[0 ... TURTLE_COUNT - 1] = TURTLE_HOME_Y};                // Position down
+static float turtle_angle[TURTLE_COUNT] = {[0 ... TURTLE_COUNT - 1] = TURTLE_DEFAULT_ANGLE};     // Heading, clockwise from up
+static uint16_t turtle_colour[TURTLE_COUNT] = {[0 ... TURTLE_COUNT - 1] = TURTLE_DEFAULT_COLOUR}; // Pen colour
+static bool turtle_pen_down[TURTLE_COUNT] = {[0 ... TURTLE_COUNT - 1] = TURTLE_DEFAULT_PEN_DOWN}; // Pen state
+static int turtle_pen_size[TURTLE_COUNT] = {[0 ... TURTLE_COUNT - 1] = TURTLE_DEFAULT_PEN_SIZE};  // Width of the pen in pixels
+static bool turtle_smooth[TURTLE_COUNT] = {[0 ... TURTLE_COUNT - 1] = TURTLE_DEFAULT_SMOOTH};     // Lines a pixel wide are anti-aliased
+static bool turtle_visible[TURTLE_COUNT] = {TURTLE_DEFAULT_VISIBILITY};                           // Shown over the graphics
+static float turtle_sine[TURTLE_COUNT] = {0};                                                     // Sine of turtle_trig_angle
+static float turtle_cosine[TURTLE_COUNT] = {[0 ... TURTLE_COUNT - 1] = 1.0f};                    // Cosine of turtle_trig_angle
+static float turtle_trig_angle[TURTLE_COUNT] = {0};                                               // Heading the sine and cosine are for
+
+// State shared by the turtles
+static uint32_t turtle_told = 1;                   // Turtles commands go to, one bit each
+static uint32_t turtle_known = 1;                  // Turtles that have been told something
+static uint32_t turtle_asked[TURTLE_ASK_DEPTH];    // Turtles being told before each ASK running
+static int turtle_ask_depth = 0;                   // ASKs running
+static int turtle_boundary = TURTLE_WRAP;          // What happens at the edges of the screen
+static int turtle_filler = -1;                     // Turtle whose path is the polygon to fill, or -1
+static int turtle_corners = 0;                     // Corners added to the polygon after the first
+static float turtle_path_x = 0.0f;                 // Position along the path while filling, not wrapped
+static float turtle_path_y = 0.0f;                 // Position along the path while filling, not wrapped
+
+// Sine of each whole degree from 0 to 90, rounded to the nearest float, so
+// multiples of 30, 45 and 90 degrees are as exact as a float can be
+static const float turtle_sines[91] = {
+    0.0f, 0.0174524064f, 0.0348994967f, 0.0523359562f, 0.0697564737f, 0.0871557427f, 0.104528463f, 0.121869343f,
+    0.139173101f, 0.156434465f, 0.173648178f, 0.190808995f, 0.207911691f, 0.224951054f, 0.241921896f, 0.258819045f,
+    0.275637356f, 0.292371705f, 0.309016994f, 0.325568154f, 0.342020143f, 0.35836795f, 0.374606593f, 0.390731128f,
+    0.406736643f, 0.422618262f, 0.438371147f, 0.4539905f, 0.469471563f, 0.48480962f, 0.5f, 0.515038075f,
+    0.529919264f, 0.544639035f, 0.559192903f, 0.573576436f, 0.587785252f, 0.601815023f, 0.615661475f, 0.629320391f,
+    0.64278761f, 0.656059029f, 0.669130606f, 0.68199836f, 0.69465837f, 0.707106781f, 0.7193398f, 0.731353702f,
+    0.743144825f, 0.75470958f, 0.766044443f, 0.777145961f, 0.788010754f, 0.79863551f, 0.809016994f, 0.819152044f,
+    0.829037573f, 0.838670568f, 0.848048096f, 0.857167301f, 0.866025404f, 0.874619707f, 0.882947593f, 0.891006524f,
+    0.898794046f, 0.906307787f, 0.913545458f, 0.920504853f, 0.927183855f, 0.933580426f, 0.939692621f, 0.945518576f,
+    0.951056516f, 0.956304756f, 0.961261696f, 0.965925826f, 0.970295726f, 0.974370065f, 0.978147601f, 0.981627183f,
+    0.984807753f, 0.987688341f, 0.990268069f, 0.992546152f, 0.994521895f, 0.996194698f, 0.99756405f, 0.998629535f,
+    0.999390827f, 0.999847695f, 1.0f,
+};
 
 //
-//  Turtle graphics functions
-//  
+//  Helper functions
+//
 
-// Clear the graphics buffer and reset the turtle to the home position
-void turtle_clearscreen(void)
+// Look up the sine of a whole number of degrees from 0 to 359
+static float whole_sine(int degrees)
 {
-    // Clear the graphics buffer
-    screen_gfx_clear();
+    if (degrees < 90)
+    {
+        return turtle_sines[degrees];
+    }
+    if (degrees < 180)
+    {
+        return turtle_sines[180 - degrees];
+    }
+    if (degrees < 270)
+    {
+        return -turtle_sines[degrees - 180];
+    }
+    return -turtle_sines[360 - degrees];
+}
+
+// Find the first turtle being told from t on, or TURTLE_COUNT if none
+static int turtle_next(int t)
+{
+    while (t < TURTLE_COUNT && !(turtle_told & (1u << t)))
+    {
+        t++;
+    }
+    return t;
+}
 
-    // Reset the turtle to the home position
-    turtle_x = TURTLE_HOME_X;
-    turtle_y = TURTLE_HOME_Y;
-    turtle_angle = TURTLE_DEFAULT_ANGLE;
+// Update the sine and cosine of a turtle's heading if it has changed. Whole
+// degrees come from the table, so the turtle turns square corners exactly.
+static void turtle_trig(int t)
+{
+    float angle = turtle_angle[t];
+    if (angle == turtle_trig_angle[t])
+    {
+        return;
+    }
 
-    // Draw the turtle at the home position
-    turtle_draw();
+    if (angle == (int)angle)
+    {
+        int degrees = ((int)angle % 360 + 360) % 360;
+        turtle_sine[t] = whole_sine(degrees);
+        turtle_cosine[t] = whole_sine((degrees + 90) % 360);
+    }
+    else
+    {
+        float radians = angle * (M_PI / 180.0f);
+        turtle_sine[t] = sinf(radians);
+        turtle_cosine[t] = cosf(radians);
+    }
+    turtle_trig_angle[t] = angle;
+}
 
-    // Update the graphics display
-    screen_gfx_update();
+// Settle a coordinate of the turtle, wrapping it only in WRAP mode
+static float turtle_wrap(float value, float size)
+{
+    return turtle_settle(value, size, turtle_boundary == TURTLE_WRAP);
 }
 
-//  Draw the turtle at the current position
-void turtle_draw()
+// Show a turtle where it is now. The screen draws it over the graphics as
+// they are sent to the LCD, so it never changes the frame buffer.
+static void turtle_show(int t)
 {
-    // Convert the angle to radians
-    float radians = turtle_angle * (M_PI / 180.0f);
+    // In WINDOW mode the turtle can be off the screen, where it is not shown
+    bool visible = turtle_visible[t] && screen_gfx_on_screen(turtle_x[t], turtle_y[t]);
 
-    // Calculate the vertices of the turtle triangle
-    float half_base = 4.0f; // Half the base width of the turtle triangle
-    float height = 12.0f;   // Height of the turtle triangle
+    turtle_trig(t);
+    screen_gfx_sprite(t, turtle_x[t], turtle_y[t], turtle_sine[t], turtle_cosine[t], turtle_colour[t], visible);
+}
 
-    // Calculate the three vertices of the triangle
-    float x1 = turtle_x + half_base * cosf(radians);
-    float y1 = turtle_y + half_base * sinf(radians);
-    float x2 = turtle_x - half_base * cosf(radians);
-    float y2 = turtle_y - half_base * sinf(radians);
-    float x3 = turtle_x + height * sinf(radians);
-    float y3 = turtle_y - height * cosf(radians);
+// Add the position along the path to the polygon being filled, or start
+// a new polygon from it
+static void turtle_corner(bool first)
+{
+    turtle_corners = first ? 0 : turtle_corners + 1;
+    screen_gfx_vertex(turtle_path_x, turtle_path_y, first);
+    picture_add_vertex(turtle_path_x, turtle_path_y, first);
+}
 
-    // Draw the triangle using lines
-    screen_gfx_line(x1, y1, x2, y2, turtle_colour, true);
-    screen_gfx_line(x2, y2, x3, y3, turtle_colour, true);
-    screen_gfx_line(x3, y3, x1, y1, turtle_colour, true);
+// Add a turtle's position to the polygon being filled after it jumps there
+static void turtle_jump(int t)
+{
+    if (t == turtle_filler)
+    {
+        turtle_path_x = turtle_x[t];
+        turtle_path_y = turtle_y[t];
+        turtle_corner(false);
+    }
 }
 
-// Move the turtle forward or backward by the specified distance
-void turtle_move(float distance)
+// Put a turtle at a position and show it there
+static void turtle_place(int t, float x, float y)
 {
-    float x = turtle_x;
-    float y = turtle_y;
+    turtle_x[t] = x;
+    turtle_y[t] = y;
+    turtle_jump(t);
+    turtle_show(t);
+}
 
-    turtle_draw();
+// Send a turtle home
+static void turtle_go_home(int t)
+{
+    turtle_angle[t] = TURTLE_DEFAULT_ANGLE;
+    turtle_place(t, TURTLE_HOME_X, TURTLE_HOME_Y);
+}
+
+// Move one turtle, returning false if it would go through the fence
+static bool turtle_step(int t, float distance)
+{
+    float x = turtle_x[t];
+    float y = turtle_y[t];
 
     // Move the turtle forward by the specified distance
-    turtle_x += distance * sinf(turtle_angle * (M_PI / 180.0f));
-    turtle_y -= distance * cosf(turtle_angle * (M_PI / 180.0f));
+    turtle_trig(t);
+    float dx = distance * turtle_sine[t];
+    float dy = -distance * turtle_cosine[t];
+    if (turtle_boundary == TURTLE_FENCE && !screen_gfx_on_screen(x + dx, y + dy))
+    {
+        return false;
+    }
+    float x2 = x + dx;
+    float y2 = y + dy;
+
+    if (t == turtle_filler)
+    {
+        // The polygon follows the path the turtle took across the edges
+        turtle_path_x += dx;
+        turtle_path_y += dy;
+        turtle_corner(false);
+    }
 
-    // Draw the turtle at the new position
-    
-    if (turtle_pen_down)
+    if (turtle_pen_down[t])
     {
         // Draw a line from the old position to the new position
-        screen_gfx_line(x, y, turtle_x, turtle_y, turtle_colour, false);
+        uint16_t colour = turtle_colour[t];
+        if (turtle_pen_size[t] > 1)
+        {
+            screen_gfx_stroke(x, y, x2, y2, turtle_pen_size[t], colour);
+            picture_add_stroke(x, y, x2, y2, turtle_pen_size[t], colour);
+        }
+        else if (turtle_smooth[t])
+        {
+            screen_gfx_smooth(x, y, x2, y2, colour);
+            picture_add_smooth(x, y, x2, y2, colour);
+        }
+        else
+        {
+            screen_gfx_line(x, y, x2, y2, colour, false);
+            picture_add_line(x, y, x2, y2, colour);
+        }
     }
 
-    turtle_draw();
-    
     // Ensure the turtle stays within bounds
-    turtle_x = fmodf(turtle_x + SCREEN_WIDTH, SCREEN_WIDTH);
-    turtle_y = fmodf(turtle_y + SCREEN_HEIGHT, SCREEN_HEIGHT);
+    turtle_x[t] = turtle_wrap(x2, SCREEN_WIDTH);
+    turtle_y[t] = turtle_wrap(y2, SCREEN_HEIGHT);
 
-    screen_gfx_update();
+    // Show the turtle at the new position
+    turtle_show(t);
+    return true;
 }
 
-// Reset the turtle to the home position
-void turtle_home(void)
+//
+//  Turtle graphics functions
+//
+
+// Wrap a coordinate onto the screen if drawing wraps. This is where the
+// turtle ends up after a move; it is only rounded to a pixel when drawn.
+float turtle_settle(float value, float size, bool wrap)
 {
-    // Draw the turtle at the home position
-    turtle_draw();
+    if (wrap)
+    {
+        value = fmodf(value + size, size);
+    }
+    return value;
+}
 
-    // Reset the turtle to the home position
-    turtle_x = TURTLE_HOME_X;
-    turtle_y = TURTLE_HOME_Y;
-    turtle_angle = TURTLE_DEFAULT_ANGLE;
+// Clear the graphics buffer and send every turtle home
+void turtle_clearscreen(void)
+{
+    // Clear the graphics buffer
+    screen_gfx_clear();
+    picture_add_clear();
 
-    // Draw the turtle at the home position
-    turtle_draw();
-    
-    screen_gfx_update();
+    for (int t = 0; t < TURTLE_COUNT; t++)
+    {
+        turtle_go_home(t);
+    }
 }
 
-// Set the turtle position to the specified coordinates
-void turtle_set_position(float x, float y)
+// Show every turtle where it is now
+void turtle_draw()
 {
-    // Draw the current turtle position before moving
-    turtle_draw();
+    for (int t = 0; t < TURTLE_COUNT; t++)
+    {
+        turtle_show(t);
+    }
+}
 
-    // Set the new position
-    turtle_x = fmodf(x + SCREEN_WIDTH, SCREEN_WIDTH);
-    turtle_y = fmodf(y + SCREEN_HEIGHT, SCREEN_HEIGHT);
+// Move the turtles forward or backward by the specified distance. Returns
+// false if any would go through the fence, leaving that one where it is.
+bool turtle_move(float distance)
+{
+    bool moved = true;
+    for (int t = turtle_next(0); t < TURTLE_COUNT; t = turtle_next(t + 1))
+    {
+        moved &= turtle_step(t, distance);
+    }
+    return moved;
+}
 
-    // Draw the turtle at the new position
-    turtle_draw();
-    screen_gfx_update();
+// Reset the turtles to the home position
+void turtle_home(void)
+{
+    for (int t = turtle_next(0); t < TURTLE_COUNT; t = turtle_next(t + 1))
+    {
+        turtle_go_home(t);
+    }
 }
 
-// Get the current turtle position
+// Set the turtles' position to the specified coordinates
+void turtle_set_position(float x, float y)
+{
+    if (turtle_boundary == TURTLE_WRAP)
+    {
+        x = fmodf(x + SCREEN_WIDTH, SCREEN_WIDTH);
+        y = fmodf(y + SCREEN_HEIGHT, SCREEN_HEIGHT);
+    }
+    for (int t = turtle_next(0); t < TURTLE_COUNT; t = turtle_next(t + 1))
+    {
+        turtle_place(t, x, y);
+    }
+}
+
+// Get the position of the first turtle being told
 void turtle_get_position(float *x, float *y)
 {
+    int t = turtle_next(0);
     if (x)
     {
-        *x = turtle_x;
+        *x = turtle_x[t];
     }
     if (y)
     {
-        *y = turtle_y;
+        *y = turtle_y[t];
     }
 }
 
-// Set the turtle angle to the specified value
+// Set the turtles' heading to the specified value
 void turtle_set_angle(float angle)
 {
-    turtle_draw();
-    turtle_angle = fmodf(angle, 360.0f); // Normalize the angle
-    turtle_draw();
+    angle = fmodf(angle, 360.0f); // Normalize the angle
+    for (int t = turtle_next(0); t < TURTLE_COUNT; t = turtle_next(t + 1))
+    {
+        turtle_angle[t] = angle;
+        turtle_show(t);
+    }
+}
+
+// Turn each of the turtles clockwise by an angle from its own heading
+void turtle_turn(float angle)
+{
+    for (int t = turtle_next(0); t < TURTLE_COUNT; t = turtle_next(t + 1))
+    {
+        turtle_angle[t] = fmodf(turtle_angle[t] + angle, 360.0f);
+        turtle_show(t);
+    }
 }
 
-// Get the current turtle angle
+// Get the heading of the first turtle being told
 float turtle_get_angle(void)
 {
-    return turtle_angle; // Return the current angle
+    return turtle_angle[turtle_next(0)];
 }
 
-// Set the turtle color to the specified value
+// Set the turtles' colour to the specified value
 void turtle_set_colour(uint16_t colour)
 {
-    // Draw the current turtle position before changing color
-    turtle_draw(turtle_x, turtle_y, turtle_angle);
-
-    // Set the new turtle color
-    turtle_colour = colour;
-
-    // Draw the turtle at the current position with the new color
-    turtle_draw(turtle_x, turtle_y, turtle_angle);
-    screen_gfx_update();
+    for (int t = turtle_next(0); t < TURTLE_COUNT; t = turtle_next(t + 1))
+    {
+        turtle_colour[t] = colour;
+        turtle_show(t); // Show the turtle in the new colour
+    }
 }
 
-// Get the current turtle color
+// Get the colour of the first turtle being told
 uint16_t turtle_get_colour(void)
 {
-    return turtle_colour; // Return the current turtle color
+    return turtle_colour[turtle_next(0)];
 }
 
 // Set the pen state (down or up)
 void turtle_set_pen_down(bool down)
 {
-    turtle_pen_down = down; // Set the pen state
+    for (int t = turtle_next(0); t < TURTLE_COUNT; t = turtle_next(t + 1))
+    {
+        turtle_pen_down[t] = down;
+    }
 }
 
-// Get the current pen state (down or up)
+// Get the pen state of the first turtle being told
 bool turtle_get_pen_down(void)
 {
-    return turtle_pen_down; // Return the current pen state
+    return turtle_pen_down[turtle_next(0)];
 }
 
-// Set the turtle visibility (visible or hidden)
-void turtle_set_visibility(bool visible)
+// Set the width of the pen in pixels, from 1 to TURTLE_PEN_SIZE_MAX
+void turtle_set_pen_size(int size)
 {
-    if (turtle_visible == visible)
+    size = MAX(1, MIN(size, TURTLE_PEN_SIZE_MAX));
+    for (int t = turtle_next(0); t < TURTLE_COUNT; t = turtle_next(t + 1))
     {
-        return; // No change in visibility
+        turtle_pen_size[t] = size;
     }
+}
+
+// Get the width of the first told turtle's pen in pixels
+int turtle_get_pen_size(void)
+{
+    return turtle_pen_size[turtle_next(0)];
+}
+
+// Set whether lines a pixel wide are anti-aliased
+void turtle_set_smooth(bool smooth)
+{
+    for (int t = turtle_next(0); t < TURTLE_COUNT; t = turtle_next(t + 1))
+    {
+        turtle_smooth[t] = smooth;
+    }
+}
+
+// Get whether the first told turtle's lines a pixel wide are anti-aliased
+bool turtle_get_smooth(void)
+{
+    return turtle_smooth[turtle_next(0)];
+}
 
-    turtle_draw(); // XOR the current turtle to draw/erase it
-    turtle_visible = visible;
+// Set the turtles' visibility (visible or hidden)
+void turtle_set_visibility(bool visible)
+{
+    for (int t = turtle_next(0); t < TURTLE_COUNT; t = turtle_next(t + 1))
+    {
+        if (turtle_visible[t] != visible)
+        {
+            turtle_visible[t] = visible;
+            turtle_show(t); // Show or hide the turtle
+        }
+    }
 }
 
-// Draw or erase the turtle based on visibility
+// Get the visibility of the first turtle being told
 bool turtle_get_visibility(void)
 {
-    return turtle_visible;
+    return turtle_visible[turtle_next(0)];
+}
+
+// Flood fill the area under each turtle with its pen colour
+void turtle_fill(void)
+{
+    for (int t = turtle_next(0); t < TURTLE_COUNT; t = turtle_next(t + 1))
+    {
+        screen_gfx_fill(turtle_x[t], turtle_y[t], turtle_colour[t]);
+        picture_add_fill(turtle_x[t], turtle_y[t], turtle_colour[t]);
+    }
+}
+
+// Start a polygon at the first turtle being told, to be filled with the
+// path it takes
+void turtle_begin_fill(void)
+{
+    int t = turtle_next(0);
+    turtle_filler = t;
+    turtle_path_x = turtle_x[t];
+    turtle_path_y = turtle_y[t];
+    turtle_corner(true);
 }
 
+// Fill the polygon started by turtle_begin_fill with its turtle's colour.
+// Returns false, filling nothing, if the polygon has more corners than the
+// screen can hold; room is kept for the edge back to the first.
+bool turtle_end_fill(void)
+{
+    if (turtle_filler < 0)
+    {
+        return true;
+    }
+    uint16_t colour = turtle_colour[turtle_filler];
+    turtle_filler = -1;
+    if (turtle_corners > FILL_CORNERS - 1)
+    {
+        return false;
+    }
+    screen_gfx_polygon(colour);
+    picture_add_polygon(colour);
+    return true;
+}
+
+// Set what happens when the turtles reach the edge of the screen. A turtle
+// left off the screen in WINDOW mode wraps back onto it for WRAP, and goes
+// home for FENCE.
+void turtle_set_boundary(int boundary)
+{
+    turtle_boundary = boundary;
+    screen_gfx_set_wrap(boundary == TURTLE_WRAP);
+
+    for (int t = 0; t < TURTLE_COUNT; t++)
+    {
+        if (!screen_gfx_on_screen(turtle_x[t], turtle_y[t]))
+        {
+            if (boundary == TURTLE_WRAP)
+            {
+                turtle_place(t, fmodf(turtle_x[t] + SCREEN_WIDTH, SCREEN_WIDTH),
+                             fmodf(turtle_y[t] + SCREEN_HEIGHT, SCREEN_HEIGHT));
+            }
+            else if (boundary == TURTLE_FENCE)
+            {
+                turtle_go_home(t);
+            }
+        }
+    }
+}
+
+// Get what happens when the turtles reach the edge of the screen
+int turtle_get_boundary(void)
+{
+    return turtle_boundary;
+}
+
+// Draw an ellipse centred on each turtle with its pen, or fill it. The
+// turtles do not move.
+void turtle_ellipse(float rx, float ry, bool filled)
+{
+    for (int t = turtle_next(0); t < TURTLE_COUNT; t = turtle_next(t + 1))
+    {
+        if (turtle_pen_down[t])
+        {
+            screen_gfx_ellipse(turtle_x[t], turtle_y[t], rx, ry, turtle_colour[t], filled);
+            picture_add_ellipse(turtle_x[t], turtle_y[t], rx, ry, turtle_colour[t], filled);
+        }
+    }
+}
+
+// Draw an arc of a circle centred on each turtle with its pen, from its
+// heading clockwise through an angle. The turtles do not move.
+void turtle_arc(float angle, float radius)
+{
+    for (int t = turtle_next(0); t < TURTLE_COUNT; t = turtle_next(t + 1))
+    {
+        if (turtle_pen_down[t])
+        {
+            screen_gfx_arc(turtle_x[t], turtle_y[t], radius, turtle_angle[t], angle, turtle_colour[t]);
+            picture_add_arc(turtle_x[t], turtle_y[t], radius, turtle_angle[t], angle, turtle_colour[t]);
+        }
+    }
+}
+
+//
+//  Telling turtles
+//
+
+// Send commands to a set of turtles, one bit each. Turtles told something
+// for the first time are shown.
+void turtle_tell(uint32_t turtles)
+{
+    uint32_t fresh = turtles & ~turtle_known;
+    turtle_told = turtles;
+    turtle_known |= turtles;
+    for (int t = 0; t < TURTLE_COUNT; t++)
+    {
+        if (fresh & (1u << t))
+        {
+            turtle_visible[t] = true;
+            turtle_show(t);
+        }
+    }
+}
+
+// Get the set of turtles commands go to, one bit each
+uint32_t turtle_get_told(void)
+{
+    return turtle_told;
+}
+
+// Send commands to a set of turtles until turtle_asked, remembering the
+// turtles told before. Returns false if too many ASKs are running.
+bool turtle_ask(uint32_t turtles)
+{
+    if (turtle_ask_depth == TURTLE_ASK_DEPTH)
+    {
+        return false;
+    }
+    turtle_asked[turtle_ask_depth++] = turtle_told;
+    turtle_tell(turtles);
+    return true;
+}
+
+// Go back to the turtles told before the innermost ASK
+void turtle_end_ask(void)
+{
+    if (turtle_ask_depth > 0)
+    {
+        turtle_told = turtle_asked[--turtle_ask_depth];
+    }
+}
+
+// Go back to the turtles told before any ASK still running, after an error
+void turtle_reset_ask(void)
+{
+    if (turtle_ask_depth > 0)
+    {
+        turtle_told = turtle_asked[0];
+        turtle_ask_depth = 0;
+    }
+}
@@ -17,6 +17,16 @@
 #define TURTLE_DEFAULT_COLOUR (0xFFFF)       // Default turtle color (white)
 #define TURTLE_DEFAULT_VISIBILITY (true)     // Default turtle visibility state
 #define TURTLE_DEFAULT_PEN_DOWN (true)       // Default turtle pen state (down)
+#define TURTLE_DEFAULT_PEN_SIZE (1)          // Default width of the pen in pixels
+#define TURTLE_PEN_SIZE_MAX (16)             // Widest pen in pixels
+#define TURTLE_DEFAULT_SMOOTH (false)        // Default for anti-aliasing lines a pixel wide
+#define TURTLE_COUNT (SPRITE_COUNT)          // Number of turtles, each shown with its own sprite
+#define TURTLE_ASK_DEPTH (8)                 // Deepest ASK inside other ASKs
+
+// Boundary modes, for what happens at the edges of the screen
+#define TURTLE_WRAP (0)   // The turtle and its lines come back on the other side
+#define TURTLE_WINDOW (1) // The turtle can go off the screen, and lines are clipped to it
+#define TURTLE_FENCE (2)  // The turtle cannot go off the screen
 
 // Simple colour definitions (Rainbow, plus black and white)
 #define COLOUR_BLACK (0x0000)   // Black
@@ -30,17 +40,37 @@
 #define COLOUR_MAGENTA (0xF81F) // Magenta
 
 // Function prototypes
+float turtle_settle(float value, float size, bool wrap);
 void turtle_clearscreen(void);
 void turtle_draw();
-void turtle_move(float distance);
+bool turtle_move(float distance);
 void turtle_home(void);
 void turtle_set_position(float x, float y);
 void turtle_get_position(float *x, float *y);
 void turtle_set_angle(float angle);
+void turtle_turn(float angle);
 float turtle_get_angle(void);
 void turtle_set_colour(uint16_t colour);
 uint16_t turtle_get_colour(void);
 void turtle_set_pen_down(bool down);
 bool turtle_get_pen_down(void);
+void turtle_set_pen_size(int size);
+int turtle_get_pen_size(void);
+void turtle_set_smooth(bool smooth);
+bool turtle_get_smooth(void);
 void turtle_set_visibility(bool visible);
 bool turtle_get_visibility(void);
+void turtle_fill(void);
+void turtle_begin_fill(void);
+bool turtle_end_fill(void);
+void turtle_ellipse(float rx, float ry, bool filled);
+void turtle_arc(float angle, float radius);
+void turtle_set_boundary(int boundary);
+int turtle_get_boundary(void);
+
+// Telling turtles
+void turtle_tell(uint32_t turtles);
+uint32_t turtle_get_told(void);
+bool turtle_ask(uint32_t turtles);
+void turtle_end_ask(void);
+void turtle_reset_ask(void);
@@ -0,0 +1,683 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+//
+//  Logo virtual machine
+//
+//  Executes bytecode produced by the compiler. The compiler has already
+//  checked the stack depth and loop nesting of each block of code, so the
+//  dispatch loop only checks for space when a procedure is called.
+//
+//  Procedure calls do not recurse in C: a call pushes a frame holding the
+//  return address and the dispatch loop carries on in the procedure's code.
+//  Inputs are bound by saving the old value of each input's symbol on the
+//  binding stack and storing the new one in the symbol, so a variable is
+//  read with a single load. Returning restores the saved values.
+//
+//  The value, loop, frame and binding stacks are allocated from the heap and
+//  doubled when a call needs more room, so deep recursion costs memory only
+//  while it runs and the C stack stays the same size. Nesting is limited to
+//  VM_CALL_DEPTH procedures, giving a Logo error instead of running out of
+//  memory.
+//
+//  The collector may run whenever a primitive builds a list or word, so the
+//  top of the value stack is recorded before each primitive runs; the
+//  values below it, and the saved bindings, are the VM's roots.
+//
+//  Pressing Break or Ctrl-C sets user_interrupt. It is only checked where a
+//  program can run for a long time: when a procedure is entered and when a
+//  loop goes round again. Even one load per iteration is a few percent of a
+//  tight loop, so a loop runs up to a limit VM_POLL_INTERVAL iterations
+//  ahead and only checks, and moves the limit on, when it gets there. The
+//  common back-edge is the same single compare it would be without the
+//  check. Straight-line code pays nothing. The same checks show the
+//  drawing done so far at most every SCREEN_FRAME_US, as the display is
+//  otherwise only updated when the REPL line finishes.
+//
+//  A tail call replaces the running procedure's frame rather than pushing a
+//  new one, so a procedure that loops by calling itself runs in constant
+//  space. The caller's inputs are unbound before the callee's are bound,
+//  which is only invisible to the callee if it rebinds every one of them;
+//  otherwise the tail call is made as an ordinary call.
+//
+
+#include <stdlib.h>
+
+#include "pico/stdlib.h"
+
+#include "evaluate.h"
+#include "picocalc/picocalc.h"
+#include "picocalc/screen.h"
+#include "primitives.h"
+#include "procedures.h"
+#include "symbols.h"
+#include "turtle.h"
+#include "vm.h"
+
+// A running REPEAT loop
+typedef struct
+{
+    int32_t count;     // Number of iterations
+    int32_t iteration; // Current iteration, starting at 1
+    int32_t limit;     // Iteration at which to check for Break
+} loop_t;
+
+// A running procedure
+typedef struct
+{
+    const uint8_t *ip;            // Where to continue in the caller
+    const procedure_t *procedure; // The procedure
+    uint32_t bindings;            // Depth of the binding stack on entry
+    uint32_t loops;               // Depth of the loop stack on entry
+} frame_t;
+
+// The previous value of a procedure input
+typedef struct
+{
+    uint16_t symbol; // Symbol id of the input
+    bool bound;      // Whether the symbol had a value
+    value_t value;   // The value it had
+} binding_t;
+
+static value_t *stack = NULL;      // Value stack
+static uint32_t stack_size = 0;    // Number of values allocated
+static uint32_t stack_top = 0;     // Values in use when a primitive was last called
+static loop_t *loops = NULL;       // Loop stack
+static uint32_t loops_size = 0;    // Number of loops allocated
+static uint32_t loop_depth = 0;    // Number of running loops
+static frame_t *frames = NULL;     // Call stack
+static uint32_t frames_size = 0;   // Number of frames allocated
+static uint32_t frame_depth = 0;   // Number of running procedures
+static binding_t *bindings = NULL; // Saved values of procedure inputs
+static uint32_t bindings_size = 0; // Number of saved values allocated
+static uint32_t binding_depth = 0; // Number of saved values
+
+//
+//  Helper functions
+//
+
+// Make room for at least the given number of entries in a stack
+static bool reserve(void **array, uint32_t *size, uint32_t needed, size_t entry)
+{
+    if (needed <= *size)
+    {
+        return true;
+    }
+
+    uint32_t grown = *size ? *size : VM_STACK_CHUNK;
+    while (grown < needed)
+    {
+        grown *= 2;
+    }
+    void *bigger = realloc(*array, grown * entry);
+    if (!bigger)
+    {
+        return false;
+    }
+    *array = bigger;
+    *size = grown;
+    return true;
+}
+
+// Make room for the values, loops and inputs of a procedure
+static bool reserve_call(const procedure_t *procedure, uint32_t values, uint32_t loop_base, uint32_t binding_base)
+{
+    return reserve((void **)&stack, &stack_size, values + procedure->code.depth, sizeof(value_t)) &&
+           reserve((void **)&loops, &loops_size, loop_base + procedure->code.loops, sizeof(loop_t)) &&
+           reserve((void **)&bindings, &bindings_size, binding_base + procedure->inputs, sizeof(binding_t));
+}
+
+// Bind the inputs of a procedure to values taken from the stack
+static void bind(const procedure_t *procedure, const value_t *values)
+{
+    for (int i = 0; i < procedure->inputs; i++)
+    {
+        symbol_t *symbol = symbol_get(procedure->params[i]);
+        binding_t *binding = &bindings[binding_depth++];
+        binding->symbol = procedure->params[i];
+        binding->bound = symbol->bound;
+        binding->value = symbol->value;
+        symbol->bound = true;
+        symbol->value = values[i];
+    }
+}
+
+// Restore the values of procedure inputs saved above the given depth
+static void unbind(uint32_t depth)
+{
+    while (binding_depth > depth)
+    {
+        binding_t *binding = &bindings[--binding_depth];
+        symbol_t *symbol = symbol_get(binding->symbol);
+        symbol->bound = binding->bound;
+        symbol->value = binding->value;
+    }
+}
+
+// Apply an operator to two whole numbers. Returns false if the result is
+// not a whole number that fits, and must be worked out with floats.
+static inline bool integer_arithmetic(uint8_t op, int32_t x, int32_t y, value_t *result)
+{
+    int32_t z;
+    switch (op)
+    {
+    case OP_ADD:
+        if (__builtin_add_overflow(x, y, &z))
+        {
+            return false;
+        }
+        *result = value_integer(z);
+        return true;
+    case OP_SUBTRACT:
+        if (__builtin_sub_overflow(x, y, &z))
+        {
+            return false;
+        }
+        *result = value_integer(z);
+        return true;
+    case OP_MULTIPLY:
+        if (__builtin_mul_overflow(x, y, &z))
+        {
+            return false;
+        }
+        *result = value_integer(z);
+        return true;
+    case OP_DIVIDE:
+        if (y == 0 || (x == INT32_MIN && y == -1) || x % y != 0)
+        {
+            return false;
+        }
+        *result = value_integer(x / y);
+        return true;
+    case OP_NEGATE:
+        if (x == INT32_MIN)
+        {
+            return false;
+        }
+        *result = value_integer(-x);
+        return true;
+    case OP_EQUAL:
+        *result = value_bool(x == y);
+        return true;
+    case OP_NOT_EQUAL:
+        *result = value_bool(x != y);
+        return true;
+    case OP_LESS:
+        *result = value_bool(x < y);
+        return true;
+    case OP_GREATER:
+        *result = value_bool(x > y);
+        return true;
+    case OP_LESS_EQUAL:
+        *result = value_bool(x <= y);
+        return true;
+    case OP_GREATER_EQUAL:
+        *result = value_bool(x >= y);
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Set the error for an operator that vm_arithmetic could not apply
+static int arithmetic_error(uint8_t op, const value_t *inputs)
+{
+    static const char *names[] = {
+        [OP_ADD] = "+",
+        [OP_SUBTRACT] = "-",
+        [OP_MULTIPLY] = "*",
+        [OP_DIVIDE] = "/",
+        [OP_NEGATE] = "-",
+        [OP_LESS] = "<",
+        [OP_GREATER] = ">",
+        [OP_LESS_EQUAL] = "<=",
+        [OP_GREATER_EQUAL] = ">=",
+    };
+
+    float number;
+    for (int i = 0; i < (op == OP_NEGATE ? 1 : 2); i++)
+    {
+        if (!value_to_number(inputs[i], &number))
+        {
+            return value_error(names[op], inputs[i]);
+        }
+    }
+    return evaluate_error("%s doesn't like 0 as input", names[op]);
+}
+
+// Check if a callee binds every input of its caller, so the caller's
+// bindings can be dropped without the callee seeing the difference
+static bool rebinds_inputs(const procedure_t *caller, const procedure_t *callee)
+{
+    for (int i = 0; i < caller->inputs; i++)
+    {
+        int j = 0;
+        while (j < callee->inputs && callee->params[j] != caller->params[i])
+        {
+            j++;
+        }
+        if (j == callee->inputs)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+//  VM functions
+//
+
+// Run compiled code to completion
+int vm_run(const code_t *code)
+{
+    int state = EVAL_STATE_COMPLETE;
+
+    loop_depth = 0;
+    frame_depth = 0;
+    user_interrupt = false;
+    if (!reserve((void **)&stack, &stack_size, code->depth, sizeof(value_t)) ||
+        !reserve((void **)&loops, &loops_size, code->loops, sizeof(loop_t)))
+    {
+        return evaluate_error("Out of memory");
+    }
+
+    const uint8_t *ip = code->bytes;
+    value_t *sp = stack;
+
+    while (true)
+    {
+        switch (*ip++)
+        {
+        case OP_END:
+        case OP_STOP:
+        {
+            if (frame_depth == 0)
+            {
+                goto done;
+            }
+            frame_t *frame = &frames[--frame_depth];
+            if (frame->procedure->outputs)
+            {
+                state = evaluate_error("%s didn't output", symbol_get(frame->procedure->name)->name);
+                goto done;
+            }
+            unbind(frame->bindings);
+            loop_depth = frame->loops;
+            ip = frame->ip;
+            break;
+        }
+
+        case OP_OUTPUT:
+        {
+            // The output stays on the stack for the caller
+            frame_t *frame = &frames[--frame_depth];
+            unbind(frame->bindings);
+            loop_depth = frame->loops;
+            ip = frame->ip;
+            break;
+        }
+
+        case OP_NUMBER:
+            *sp++ = value_number(code_read_float(ip));
+            ip += sizeof(float);
+            break;
+
+        case OP_INTEGER:
+            *sp++ = value_integer(code_read_i32(ip));
+            ip += sizeof(int32_t);
+            break;
+
+        case OP_WORD:
+            *sp++ = value_word(code_read_u16(ip));
+            ip += sizeof(uint16_t);
+            break;
+
+        case OP_LIST:
+        {
+            const char *text = code_read_pointer(ip);
+            ip += sizeof(text);
+            uint16_t length = code_read_u16(ip);
+            ip += sizeof(uint16_t);
+
+            stack_top = sp - stack;
+            if (!heap_parse_list(text, length, sp))
+            {
+                state = EVAL_STATE_ERROR;
+                goto done;
+            }
+            sp++;
+            break;
+        }
+
+        case OP_VARIABLE:
+        {
+            symbol_t *symbol = symbol_get(code_read_u16(ip));
+            ip += sizeof(uint16_t);
+            if (!symbol->bound)
+            {
+                state = evaluate_error("%s has no value", symbol->name);
+                goto done;
+            }
+            *sp++ = symbol->value;
+            break;
+        }
+
+        case OP_PRIMITIVE:
+        {
+            const primitive_t *primitive = &primitives[*ip++];
+            stack_top = sp - stack;
+            sp -= primitive->inputs;
+            state = primitive->handler(sp, sp);
+            if (state != EVAL_STATE_COMPLETE)
+            {
+                goto done;
+            }
+            if (primitive->outputs)
+            {
+                sp++;
+            }
+            break;
+        }
+
+        case OP_TAIL_CALL:
+        case OP_CALL:
+        {
+            bool tail = ip[-1] == OP_TAIL_CALL;
+            procedure_t *procedure = &procedures[code_read_u16(ip)];
+            ip += sizeof(uint16_t);
+
+            if (user_interrupt)
+            {
+                state = evaluate_error("Stopped");
+                goto done;
+            }
+            screen_gfx_refresh();
+            state = procedure_prepare(procedure);
+            if (state != EVAL_STATE_COMPLETE)
+            {
+                goto done;
+            }
+
+            // The inputs are on the stack in order
+            sp -= procedure->inputs;
+            uint32_t values = sp - stack;
+
+            frame_t *frame;
+            if (tail && rebinds_inputs(frames[frame_depth - 1].procedure, procedure))
+            {
+                // Reuse the caller's frame, keeping its return address
+                frame = &frames[frame_depth - 1];
+                if (!reserve_call(procedure, values, frame->loops, frame->bindings))
+                {
+                    state = evaluate_error("Out of memory calling %s", symbol_get(procedure->name)->name);
+                    goto done;
+                }
+                sp = stack + values;
+                unbind(frame->bindings);
+                loop_depth = frame->loops;
+            }
+            else
+            {
+                if (frame_depth == VM_CALL_DEPTH)
+                {
+                    state = evaluate_error("%s recursed too deeply", symbol_get(procedure->name)->name);
+                    goto done;
+                }
+                if (!reserve((void **)&frames, &frames_size, frame_depth + 1, sizeof(frame_t)) ||
+                    !reserve_call(procedure, values, loop_depth, binding_depth))
+                {
+                    state = evaluate_error("Out of memory calling %s", symbol_get(procedure->name)->name);
+                    goto done;
+                }
+                sp = stack + values;
+                frame = &frames[frame_depth++];
+                frame->ip = ip;
+                frame->bindings = binding_depth;
+                frame->loops = loop_depth;
+            }
+
+            frame->procedure = procedure;
+            bind(procedure, sp);
+            ip = procedure->code.bytes;
+            break;
+        }
+
+        case OP_JUMP:
+            ip += code_read_u16(ip) + sizeof(uint16_t);
+            break;
+
+        case OP_JUMP_FALSE:
+        {
+            uint16_t offset = code_read_u16(ip);
+            ip += sizeof(uint16_t);
+
+            bool truth;
+            if (!value_to_bool(*--sp, &truth))
+            {
+                state = value_error("if", *sp);
+                goto done;
+            }
+            if (!truth)
+            {
+                ip += offset;
+            }
+            break;
+        }
+
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+        case OP_DIVIDE:
+        case OP_LESS:
+        case OP_GREATER:
+        case OP_LESS_EQUAL:
+        case OP_GREATER_EQUAL:
+        {
+            uint8_t op = ip[-1];
+            value_t *inputs = --sp - 1;
+            if (inputs[0].type == VALUE_INTEGER && inputs[1].type == VALUE_INTEGER &&
+                integer_arithmetic(op, inputs[0].integer, inputs[1].integer, inputs))
+            {
+                break;
+            }
+            if (!vm_arithmetic(op, inputs[0], inputs[1], inputs))
+            {
+                state = arithmetic_error(op, inputs);
+                goto done;
+            }
+            break;
+        }
+
+        case OP_NEGATE:
+            if (!vm_arithmetic(OP_NEGATE, sp[-1], sp[-1], sp - 1))
+            {
+                state = arithmetic_error(OP_NEGATE, sp - 1);
+                goto done;
+            }
+            break;
+
+        case OP_EQUAL:
+        case OP_NOT_EQUAL:
+        {
+            value_t *inputs = --sp - 1;
+            bool equal = value_equal(inputs[0], inputs[1]);
+            *inputs = value_bool(equal == (ip[-1] == OP_EQUAL));
+            break;
+        }
+
+        case OP_REPEAT:
+        {
+            uint16_t exit = code_read_u16(ip);
+            ip += sizeof(uint16_t);
+
+            int32_t count;
+            if (!value_to_integer(*--sp, &count))
+            {
+                state = value_error("repeat", *sp);
+                goto done;
+            }
+            if (count < 1)
+            {
+                ip += exit;
+                break;
+            }
+            loops[loop_depth].count = count;
+            loops[loop_depth].iteration = 1;
+            loops[loop_depth].limit = count < VM_POLL_INTERVAL ? count : VM_POLL_INTERVAL;
+            loop_depth++;
+            break;
+        }
+
+        case OP_LOOP:
+        {
+            uint16_t body = code_read_u16(ip);
+            ip += sizeof(uint16_t);
+
+            loop_t *loop = &loops[loop_depth - 1];
+            if (loop->iteration < loop->limit)
+            {
+                loop->iteration++;
+                ip -= body;
+            }
+            else if (loop->iteration < loop->count)
+            {
+                if (user_interrupt)
+                {
+                    state = evaluate_error("Stopped");
+                    goto done;
+                }
+                screen_gfx_refresh();
+                int32_t remaining = loop->count - loop->iteration;
+                loop->limit = loop->iteration + (remaining < VM_POLL_INTERVAL ? remaining : VM_POLL_INTERVAL);
+                loop->iteration++;
+                ip -= body;
+            }
+            else
+            {
+                loop_depth--;
+            }
+            break;
+        }
+
+        case OP_ASK:
+        {
+            uint32_t turtles;
+            if (!primitive_turtles(*--sp, &turtles))
+            {
+                state = value_error("ask", *sp);
+                goto done;
+            }
+            if (!turtle_ask(turtles))
+            {
+                state = evaluate_error("Too many nested asks");
+                goto done;
+            }
+            break;
+        }
+
+        case OP_ASKED:
+            turtle_end_ask();
+            break;
+
+        default:
+            state = evaluate_error("Bad instruction %d", ip[-1]);
+            goto done;
+        }
+    }
+
+done:
+    // Leave no procedure inputs bound, and no turtles asked, after an error
+    unbind(0);
+    turtle_reset_ask();
+    frame_depth = 0;
+    loop_depth = 0;
+    stack_top = 0;
+    return state;
+}
+
+// Apply an arithmetic or comparison opcode to two values, or to x alone for
+// OP_NEGATE. Whole numbers give a whole result unless it would overflow or
+// has a fraction. Returns false if an input is not a number or on division
+// by zero. The compiler uses this to fold constants.
+bool vm_arithmetic(uint8_t op, value_t x, value_t y, value_t *result)
+{
+    if (x.type == VALUE_INTEGER && y.type == VALUE_INTEGER &&
+        integer_arithmetic(op, x.integer, y.integer, result))
+    {
+        return true;
+    }
+
+    float a, b;
+    if (!value_to_number(x, &a) || !value_to_number(y, &b))
+    {
+        return false;
+    }
+    switch (op)
+    {
+    case OP_ADD:
+        *result = value_number(a + b);
+        return true;
+    case OP_SUBTRACT:
+        *result = value_number(a - b);
+        return true;
+    case OP_MULTIPLY:
+        *result = value_number(a * b);
+        return true;
+    case OP_DIVIDE:
+        if (b == 0.0f)
+        {
+            return false;
+        }
+        *result = value_number(a / b);
+        return true;
+    case OP_NEGATE:
+        *result = value_number(-a);
+        return true;
+    case OP_EQUAL:
+        *result = value_bool(a == b);
+        return true;
+    case OP_NOT_EQUAL:
+        *result = value_bool(a != b);
+        return true;
+    case OP_LESS:
+        *result = value_bool(a < b);
+        return true;
+    case OP_GREATER:
+        *result = value_bool(a > b);
+        return true;
+    case OP_LESS_EQUAL:
+        *result = value_bool(a <= b);
+        return true;
+    case OP_GREATER_EQUAL:
+        *result = value_bool(a >= b);
+        return true;
+    default:
+        return false;
+    }
+}
+
+// The iteration number of the innermost REPEAT, or -1 outside a loop
+int vm_repcount(void)
+{
+    return loop_depth ? loops[loop_depth - 1].iteration : -1;
+}
+
+// Mark the values on the stack and in saved bindings for the collector
+void vm_mark_roots(void)
+{
+    for (uint32_t i = 0; i < stack_top; i++)
+    {
+        heap_mark(stack[i]);
+    }
+    for (uint32_t i = 0; i < binding_depth; i++)
+    {
+        if (bindings[i].bound)
+        {
+            heap_mark(bindings[i].value);
+        }
+    }
+}
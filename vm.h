@@ -0,0 +1,27 @@
+//
+//  PicoCalc Logo
+//  Copyright Blair Leduc.
+//  See LICENSE for details.
+//
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#include "bytecode.h"
+#include "heap.h"
+
+// VM limits
+#ifndef VM_CALL_DEPTH
+#define VM_CALL_DEPTH (1000) // Deepest nesting of procedure calls, not counting tail calls
+#endif
+#define VM_STACK_CHUNK (64)  // Entries each control stack starts with, doubled as needed
+#ifndef VM_POLL_INTERVAL
+#define VM_POLL_INTERVAL (32) // Loop iterations between checks for Break
+#endif
+
+// Function prototypes
+int vm_run(const code_t *code);
+int vm_repcount(void);
+bool vm_arithmetic(uint8_t op, value_t x, value_t y, value_t *result);
+void vm_mark_roots(void);